@@ -0,0 +1,43 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// (c) William Fonkou Tambe
+
+#ifndef BAUDNEG_H
+#define BAUDNEG_H
+
+// Protocol used by the BIOS and host tools to agree on a UART
+// baudrate faster than the one used at boot.
+// - The host repeatedly sends BAUDNEG_RQST while the BIOS boots;
+//   the BIOS replies BAUDNEG_ACK if it receives it while waiting
+//   for it after having initialized the UART.
+// - For each baudrate to try, in increasing order, the host sends
+//   BAUDNEG_CMDRATE followed by the baudrate as 4 bytes in little-endian;
+//   the BIOS replies BAUDNEG_NO if it cannot generate the baudrate accurately,
+//   otherwise BAUDNEG_YES, after which both sides switch to the baudrate.
+//   The host then sends the BAUDNEG_PATTERNSZ bytes from baudneg_pattern(),
+//   which the BIOS echoes if received intact; the host then sends
+//   BAUDNEG_CMDKEEP if it received the echo intact, and the BIOS
+//   replies BAUDNEG_ACK, making the baudrate the one to keep.
+// - A side not receiving what it expects within BAUDNEG_TIMEOUT
+//   milliseconds reverts to the baudrate last kept; the host waits twice
+//   as long before resuming at that baudrate, and stops trying faster ones.
+// - The host ends the negotiation with BAUDNEG_CMDDONE; the BIOS also ends it
+//   when no command is received within BAUDNEG_IDLE milliseconds.
+
+#define BAUDNEG_RQST		"\033BN?"
+#define BAUDNEG_ACK		'!'
+#define BAUDNEG_CMDRATE		'R'
+#define BAUDNEG_CMDKEEP		'K'
+#define BAUDNEG_CMDDONE		'D'
+#define BAUDNEG_YES		'y'
+#define BAUDNEG_NO		'n'
+#define BAUDNEG_PATTERNSZ	64
+#define BAUDNEG_TIMEOUT		200 /* ms */
+#define BAUDNEG_IDLE		1000 /* ms */
+
+// Return the byte at the index given by the argument i of the test pattern;
+// it alternates bit polarities while walking through all byte values.
+static inline unsigned char baudneg_pattern (unsigned long i) {
+	return (((i&1) ? 0x55 : 0xaa) ^ (i*37));
+}
+
+#endif /* BAUDNEG_H */
@@ -0,0 +1,45 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// (c) William Fonkou Tambe
+
+#ifndef TTYSPEED_H
+#define TTYSPEED_H
+
+// Used by host tools to set tty speeds.
+#include <termios.h>
+
+// Return the tty speed value corresponding to the baudrate
+// given as argument, or B0 if the baudrate is not supported.
+static speed_t ttyspeed (unsigned long baudrate) {
+	switch (baudrate) {
+		case 9600: return B9600;
+		case 19200: return B19200;
+		case 38400: return B38400;
+		case 57600: return B57600;
+		case 115200: return B115200;
+		case 230400: return B230400;
+		#ifdef B460800
+		case 460800: return B460800;
+		#endif
+		#ifdef B921600
+		case 921600: return B921600;
+		#endif
+		#ifdef B1000000
+		case 1000000: return B1000000;
+		#endif
+		#ifdef B1500000
+		case 1500000: return B1500000;
+		#endif
+		#ifdef B2000000
+		case 2000000: return B2000000;
+		#endif
+		#ifdef B3000000
+		case 3000000: return B3000000;
+		#endif
+		#ifdef B4000000
+		case 4000000: return B4000000;
+		#endif
+		default: return B0;
+	}
+}
+
+#endif /* TTYSPEED_H */
@@ -12,6 +12,9 @@
 		:  "=r"(n));		\
 	n; })
 
+#include <stdint.h>
+#include "warmboot.h"
+
 static unsigned char stack[STACKSZ] __attribute__((used));
 
 // Substitute for crt0.S since this is built using -nostdlib.
@@ -22,10 +25,47 @@ __asm__ (
 	".p2align 1\n"
 	"_start:\n"
 
+	#ifdef LDRWARMBOOT
+	// Skip the checksum stored by main() for the loader.
+	"rli8 %sr, 0f; j %sr\n"
+	".p2align 3\n"
+	".global  ___bioscsum\n"
+	"___bioscsum: .fill 2, "__xstr__(__SIZEOF_POINTER__)", 0\n"
+	".if (___bioscsum - _start) != "__xstr__(BIOSCSUMOFFS)"\n"
+	".error \"___bioscsum must be at BIOSCSUMOFFS\"\n"
+	".endif\n"
+	".fill 2, 4, 0\n" // At BIOSPARTOFFS, written by the loader.
+	".p2align 5\n" // Aligned such that the checksummed region starts at BIOSCSUMSTART.
+	"0:\n"
+	#endif
+
 	// Initialize %sp and %fp.
 	"rli %sp, stack + "__xstr__(STACKSZ)"\n"
 	//"li8 %fp, 0\n" // ### Disabled, as it is unnecessary.
-	#if 0 // ### Disabled, as section .bss is loaded in memory having been already zeroed.
+	#ifdef LDRWARMBOOT // otherwise disabled, as section .bss is loaded in memory having been already zeroed.
+	// When the checksum is null, the BIOS has just been loaded,
+	// and its initialized data get saved, otherwise the loader
+	// found the BIOS intact and warm started it, hence the
+	// initialized data get restored and .bss zeroed.
+	"rli %sr, ___bioscsum\n"
+	"ld %5, %sr\n"
+	"rli %1, __datasave\n"
+	"rli %2, __data_start\n"
+	"rli %3, _edata\n"
+	"sub %3, %2\n"
+	#if __SIZEOF_POINTER__ == 8
+	"li8 %4, 3\n"
+	#else
+	"li8 %4, 2\n"
+	#endif
+	"srl %3, %4\n"
+	"rli %sr, 0f\n"
+	"jz %5, %sr\n"
+	"cpy %4, %1; cpy %1, %2; cpy %2, %4\n"
+	"0: rli %sr, uintcpy\n"
+	"jl %rp, %sr\n"
+	"rli %sr, 1f\n"
+	"jz %5, %sr\n"
 	// Zero section .bss .
 	"rli %8, __bss_start\n"
 	"rli %9, __bss_end\n"
@@ -135,7 +175,6 @@ void *u8cpy (void *dst, const void *src, unsigned long cnt); __asm__ (
 	".size    u8cpy, (. - u8cpy)\n");
 
 #include <hwdrvdevtbl/hwdrvdevtbl.h>
-hwdrvdevtbl hwdrvdevtbl_ram = {.e = (devtblentry *)0, .id = 1 /* RAM device */};
 
 #include <hwdrvintctrl/hwdrvintctrl.h>
 
@@ -178,6 +217,113 @@ static unsigned long getclkfreq (void) {
 	return freq;
 }
 
+// Mailbox of a parked core; a function posted to it with parkpu_post()
+// gets run by the core, which gets woken with an inter-processor
+// interrupt, and goes back to sleep in parkpu() afterwards.
+typedef struct {
+	// Function to run, and its argument; fn is null when none is posted,
+	// and gets nulled by the core once the function has returned.
+	void (* volatile fn) (void *arg);
+	void * volatile arg;
+	// Count of functions run.
+	volatile unsigned long donecnt;
+	// Lower bits of the clock cycle count when the function was posted,
+	// and clock cycles from then to the core running it, ie: wake latency.
+	volatile unsigned long postclkcyclecnt, wakeclkcyclecnt;
+} parkpu_mbox;
+
+parkpu_mbox parkpu_mboxes[MAXCORECNT];
+
+#if (MAXCORECNT > 1)
+// Stack of a parked core while it runs parkpu_mboxrun(), which limits what
+// functions posted with parkpu_post() can do; from -fstack-usage outputs,
+// parkpu_mboxrun() with ramscrub_core(), the deepest posted, uses about 104 bytes.
+#define PARKPUSTACKSZLOG2 8
+static unsigned char parkpu_stack[MAXCORECNT][1<<PARKPUSTACKSZLOG2] __attribute__((used));
+
+// Run by a parked core once woken, the function posted to its mailbox.
+void parkpu_mboxrun (void) {
+	unsigned long now, id = getcoreid();
+	__asm__ __volatile__ ("getclkcyclecnt %0" : "=r" (now));
+	// Acknowledge the inter-processor interrupt without re-enabling the delivery
+	// of interrupts to this core, since a parked core does not service them;
+	// a device interrupt delivered to this core meanwhile gets dispatched
+	// to its handler instead of being dropped.
+	unsigned long idx;
+	while ((idx = hwdrvintctrl_ack (id, 0)) != (unsigned long)-2) {
+		if (idx < HWDRVINTCTRL_SRCMAX && hwdrvintctrl_srcs[idx].fn)
+			hwdrvintctrl_srcs[idx].fn (hwdrvintctrl_srcs[idx].arg);
+	}
+	parkpu_mbox *m = &parkpu_mboxes[id];
+	void (*fn)(void *) = m->fn;
+	if (!fn)
+		return;
+	m->wakeclkcyclecnt = (now - m->postclkcyclecnt);
+	fn (m->arg);
+	++m->donecnt;
+	m->fn = (void (*)(void *))0;
+}
+
+// Where parkpu() jumps once the core is woken, until the kernel patches
+// its rli16 immediate; it sets up the stack of the core, and returns
+// to parkpu() once parkpu_mboxrun() returns.
+void parkpu_mboxentry (void); __asm__ (
+	".text\n"
+	".global  parkpu_mboxentry\n"
+	".type    parkpu_mboxentry, @function\n"
+	".p2align 1\n"
+	"parkpu_mboxentry:\n"
+
+	"getcoreid %1\n"
+	"inc8 %1, 1\n"
+	"li8 %2, "__xstr__(PARKPUSTACKSZLOG2)"\n"
+	"sll %1, %2\n"
+	"rli %sp, parkpu_stack\n"
+	"add %sp, %1\n"
+	"rli %sr, parkpu_mboxrun\n"
+	"jl %rp, %sr\n"
+	"li %sr, "__xstr__(KERNELADDR)" - "__xstr__(PARKPUSZ)"\n"
+	"j %sr\n"
+
+	".size    parkpu_mboxentry, (. - parkpu_mboxentry)\n");
+
+// Make the parkpu() installed at (KERNELADDR - PARKPUSZ) jump to parkpu_mboxentry
+// once woken, instead of halting again; the rli16 immediate is relative, hence
+// its base is retrieved from its value, which then targets the halt of parkpu().
+static void parkpu_mboxinstall (void) {
+	uint16_t *imm = (uint16_t *)(KERNELADDR - (PARKPUSZ - 14));
+	unsigned long base = (((KERNELADDR - PARKPUSZ) + 6) - (signed long)(int16_t)*imm);
+	*imm = ((unsigned long)&parkpu_mboxentry - base);
+}
+
+// Post to the mailbox of the parked core given by the argument id, the function
+// given by the argument fn to be run with the argument arg, and wake the core.
+// The function runs on parkpu_stack, hence it and its callees must fit
+// in (1<<PARKPUSTACKSZLOG2) bytes along with parkpu_mboxrun().
+// Returns null if there is no such core, or if a function is already posted.
+static unsigned long parkpu_post (unsigned long id, void (*fn)(void *), void *arg) {
+	if (!id || id >= MAXCORECNT || parkpu_mboxes[id].fn)
+		return 0;
+	parkpu_mbox *m = &parkpu_mboxes[id];
+	m->arg = arg;
+	__asm__ __volatile__ ("getclkcyclecnt %0" : "=r" (m->postclkcyclecnt));
+	m->fn = fn;
+	unsigned long n;
+	while ((n = hwdrvintctrl_int (id)) == (unsigned long)-2);
+	if (n == (unsigned long)-1) {
+		m->fn = (void (*)(void *))0;
+		return 0;
+	}
+	return 1;
+}
+
+// Wait for the function posted with parkpu_post() to the core
+// given by the argument id to have returned.
+static void parkpu_wait (unsigned long id) {
+	while (parkpu_mboxes[id].fn);
+}
+#endif
+
 // Structure describing the MBR.
 struct __attribute__((packed)) {
 	unsigned char bootcode[446];
@@ -189,7 +335,7 @@ struct __attribute__((packed)) {
 		uint32_t lba_begin;
 		uint32_t sect_cnt;
 	} partition_entry[4];
-} *mbr = (void *)BLKDEVADDR;
+} *mbr;
 
 #include <hwdrvblkdev/hwdrvblkdev.h>
 hwdrvblkdev hwdrvblkdev_dev = {.addr = (void *)BLKDEVADDR};
@@ -197,11 +343,395 @@ hwdrvblkdev hwdrvblkdev_dev = {.addr = (void *)BLKDEVADDR};
 #include <hwdrvchar/hwdrvchar.h>
 hwdrvchar hwdrvchar_dev = {.addr = (void *)UARTADDR};
 
+// BIOS work spawned with coroutine_spawn() runs at busy points.
+#include <coroutine/coroutine.h>
+
+// UART transmit and receive rings.
+// The UART has no transmit-empty interrupt, and once the kernel runs,
+// interrupts get delivered to it only, hence the rings get serviced
+// by uart_pump() whenever the BIOS runs: at every syscall, and at busy
+// points through uart_co; while the BIOS boots, the receive interrupt
+// only hints uart_service() that there are bytes to receive.
+// The bytes in a ring are from its field tail to its field head,
+// which are free-running indexes.
+typedef struct {
+	unsigned char buf[UARTRINGSZ];
+	unsigned long head, tail;
+} uartring;
+uartring uart_txring, uart_rxring;
+
+#if (MAXCORECNT > 1)
+#include <mutex/mutex.h>
+// Lock to hold while using the rings.
+mutex uart_mutex = {0, 0, 0};
+#endif
+
+// Copy into the ring given by the argument r, up to sz bytes
+// from the buffer given by the argument ptr.
+// Returns the byte amount copied.
+static unsigned long uartring_put (uartring *r, unsigned char *ptr, unsigned long sz) {
+	unsigned long n = (UARTRINGSZ - (r->head - r->tail));
+	if (sz > n)
+		sz = n;
+	for (n = 0; n < sz; ++n)
+		r->buf[(r->head++)&(UARTRINGSZ-1)] = ptr[n];
+	return sz;
+}
+
+// Copy from the ring given by the argument r, up to sz bytes
+// into the buffer given by the argument ptr.
+// Returns the byte amount copied.
+static unsigned long uartring_get (uartring *r, unsigned char *ptr, unsigned long sz) {
+	unsigned long n = (r->head - r->tail);
+	if (sz > n)
+		sz = n;
+	for (n = 0; n < sz; ++n)
+		ptr[n] = r->buf[(r->tail++)&(UARTRINGSZ-1)];
+	return sz;
+}
+
+// Move bytes from the transmit ring to the UART, and when
+// the argument rx is non-null, from the UART to the receive ring.
+static void uart_pump (unsigned long rx) {
+	unsigned long n, i;
+	while ((n = (uart_txring.head - uart_txring.tail))) {
+		i = (uart_txring.tail&(UARTRINGSZ-1));
+		if (n > (UARTRINGSZ - i))
+			n = (UARTRINGSZ - i);
+		if (!(n = hwdrvchar_write (&hwdrvchar_dev, &uart_txring.buf[i], n)))
+			break;
+		uart_txring.tail += n;
+	}
+	while (rx && (n = (UARTRINGSZ - (uart_rxring.head - uart_rxring.tail)))) {
+		i = (uart_rxring.head&(UARTRINGSZ-1));
+		if (n > (UARTRINGSZ - i))
+			n = (UARTRINGSZ - i);
+		if (!(n = hwdrvchar_read (&hwdrvchar_dev, &uart_rxring.buf[i], n)))
+			break;
+		uart_rxring.head += n;
+	}
+}
+
+// Wait for the transmit ring to have been written to the UART.
+static void uart_flush (void) {
+	while (uart_txring.head != uart_txring.tail)
+		uart_pump (0);
+}
+
+// Non-null while the UART interrupt is used.
+unsigned long uart_rxintrena;
+// Moderation of the UART interrupt, which threshold is adapted to
+// the receive byte rate; its field budget is also the polling period.
+hwdrvchar_rxmod uart_rxmod;
+// Non-null when the UART interrupted since uart_service() last filled the receive ring.
+volatile unsigned long uart_rxintr;
+
+// Handler of the UART interrupt; it can run at a busy point within uart_pump(),
+// hence it does not use the rings, and disables the interrupt until uart_service()
+// has filled the receive ring, so that it does not fire again meanwhile.
+static void uart_intrhdlr (void *_) {
+	uart_rxintr = 1;
+	hwdrvchar_interrupt (&hwdrvchar_dev, 0);
+}
+
+// Same as uart_pump(), but filling the receive ring at most every
+// uart_rxmod.budget, unless the UART interrupted, since when no received byte
+// is accounted for by the UART driver, it costs a read of the UART status;
+// the polling also flushes the bytes which did not reach the interrupt threshold.
+static void uart_service (void) {
+	static uint64_t rxclkcyclecnt = 0;
+	#if (MAXCORECNT > 1)
+	mutex_lock (&uart_mutex); // Done for multicore support.
+	#endif
+	uint64_t now = getclkcyclecnt().val;
+	unsigned long rx = (uart_rxintr || (now - rxclkcyclecnt) >= uart_rxmod.budget);
+	if (rx) {
+		rxclkcyclecnt = now;
+		uart_rxintr = 0;
+	}
+	unsigned long head = uart_rxring.head;
+	uart_pump (rx);
+	if (rx) {
+		unsigned long threshold = hwdrvchar_rxmod_update (
+			&uart_rxmod, (uart_rxring.head - head), now);
+		// The interrupt gets re-enabled, since uart_intrhdlr() disables it.
+		if (uart_rxintrena)
+			hwdrvchar_interrupt (&hwdrvchar_dev, threshold);
+	}
+	#if (MAXCORECNT > 1)
+	mutex_unlock (&uart_mutex);
+	#endif
+}
+
+// Non-null while the BIOS dispatches interrupts; hwdrvintctrl_drain() gets called
+// from intr_co at busy points, so that a burst of interrupts costs a single call.
+unsigned long intr_enabled;
+coroutine intr_co;
+static unsigned long intr_cofn (coroutine *co) {
+	CO_BEGIN(co);
+	while (intr_enabled) {
+		hwdrvintctrl_drain (getcoreid());
+		CO_YIELD(co);
+	}
+	CO_END(co);
+}
+
+// Coroutine servicing the UART rings at busy points.
+coroutine uart_co;
+static unsigned long uart_cofn (coroutine *co) {
+	CO_BEGIN(co);
+	while (1) {
+		uart_service();
+		CO_YIELD(co);
+	}
+	CO_END(co);
+}
+
+// The transmit ring is used as line buffer: it gets written
+// to the UART on newline, or when it is full; uart_flush()
+// must be used before parking or jumping to the kernel.
 int putchar (int c) {
-	while (!hwdrvchar_write(&hwdrvchar_dev, &c, 1));
+	while (!uartring_put (&uart_txring, (unsigned char *)&c, 1)) {
+		uart_pump (0);
+		coroutine_sched();
+	}
+	if (c == '\n')
+		uart_pump (0);
 	return c;
 }
 
+// UART boot mode, in which the kernel is received through the UART.
+#include <uartboot/uartboot.h>
+
+// Set non-null when UART boot mode was requested.
+unsigned long uartboot_rqst = 0;
+
+#if (BAUDNEGWAIT > 0)
+#include <baudneg/baudneg.h>
+
+// Return the next byte received within the amount of clock cycles
+// given by the argument t, or -1 if none was received.
+static signed long baudneg_getc (uint64_t t) {
+	uint64_t start = getclkcyclecnt().val;
+	unsigned char c;
+	do {
+		if (hwdrvchar_read (&hwdrvchar_dev, &c, 1))
+			return c;
+	} while ((getclkcyclecnt().val - start) < t);
+	return -1;
+}
+
+static void baudneg_putc (unsigned char c) {
+	while (!hwdrvchar_write (&hwdrvchar_dev, &c, 1));
+}
+
+// Switch to the baudrate given by the argument baudrate, after
+// the bytes written at the baudrate given by the argument oldbaudrate
+// have been sent; bytes received until then get discarded.
+static void baudneg_setspeed (unsigned long baudrate, unsigned long oldbaudrate) {
+	while (hwdrvchar_writable (&hwdrvchar_dev) != hwdrvchar_dev.bufsz);
+	// Wait for the byte being shifted out, with margin.
+	uint64_t start = getclkcyclecnt().val;
+	while ((getclkcyclecnt().val - start) < ((hwdrvchar_dev.clkfreq*20)/oldbaudrate));
+	hwdrvchar_setspeed (&hwdrvchar_dev, baudrate);
+	unsigned char c;
+	while (hwdrvchar_read (&hwdrvchar_dev, &c, 1));
+}
+
+// Negotiate with the host the baudrate to use as described
+// in baudneg.h, starting at the baudrate given as argument.
+// Returns the baudrate agreed.
+static unsigned long baudneg (unsigned long baudrate) {
+	uint64_t ms = (hwdrvchar_dev.clkfreq/1000);
+	uint64_t start = getclkcyclecnt().val;
+	unsigned long i = 0;
+	while (i < (sizeof(BAUDNEG_RQST)-1)) {
+		uint64_t elapsed = (getclkcyclecnt().val - start);
+		if (elapsed >= (BAUDNEGWAIT*ms))
+			return baudrate;
+		signed long c = baudneg_getc ((BAUDNEGWAIT*ms) - elapsed);
+		if (c < 0)
+			return baudrate;
+		if (c == UARTBOOT_KEY)
+			uartboot_rqst = 1;
+		i = ((c == BAUDNEG_RQST[i]) ? (i+1) : (c == BAUDNEG_RQST[0]));
+	}
+	baudneg_putc (BAUDNEG_ACK);
+	while (1) {
+		signed long c = baudneg_getc (BAUDNEG_IDLE*ms);
+		if (c < 0 || c == BAUDNEG_CMDDONE)
+			break;
+		if (c == UARTBOOT_KEY)
+			uartboot_rqst = 1;
+		if (c != BAUDNEG_CMDRATE)
+			continue; // Ignore the tail of requests repeated by the host.
+		unsigned long rate = 0;
+		for (i = 0; i < 4; ++i) {
+			if ((c = baudneg_getc (BAUDNEG_TIMEOUT*ms)) < 0)
+				break;
+			rate |= ((unsigned long)c << (i*8));
+		}
+		if (i < 4)
+			continue;
+		// The baudrate is accepted only if the divisor
+		// generates it within 2% and is large enough
+		// for the UART to sample bits.
+		unsigned long div = (rate ? (hwdrvchar_dev.clkfreq/rate) : 0);
+		if (div < 8) {
+			baudneg_putc (BAUDNEG_NO);
+			continue;
+		}
+		unsigned long actual = (hwdrvchar_dev.clkfreq/div);
+		if (((actual - rate)*50) > rate) {
+			baudneg_putc (BAUDNEG_NO);
+			continue;
+		}
+		baudneg_putc (BAUDNEG_YES);
+		baudneg_setspeed (rate, baudrate);
+		for (i = 0; i < BAUDNEG_PATTERNSZ; ++i)
+			if (baudneg_getc (BAUDNEG_TIMEOUT*ms) != baudneg_pattern(i))
+				goto revert;
+		for (i = 0; i < BAUDNEG_PATTERNSZ; ++i)
+			baudneg_putc (baudneg_pattern(i));
+		if (baudneg_getc (BAUDNEG_TIMEOUT*ms) != BAUDNEG_CMDKEEP)
+			goto revert;
+		baudneg_putc (BAUDNEG_ACK);
+		baudrate = rate;
+		continue;
+		revert:
+		baudneg_setspeed (baudrate, rate);
+	}
+	return baudrate;
+}
+#endif
+
+// Return non-null if a RAM device spans from KERNELADDR
+// through the byte amount given by the argument sz.
+static unsigned long kernelramfits (unsigned long sz) {
+	hwdrvdevtbl_ent *ram = hwdrvdevtbl_at ((void *)KERNELADDR);
+	return (ram && ram->id == 1 /* RAM device */ &&
+		(ram->addr + (ram->mapsz*sizeof(unsigned long))) >= ((void *)KERNELADDR + sz));
+}
+
+// UART boot mode goes through the rings like the rest of the BIOS,
+// such that bytes already moved into the receive ring, for instance
+// the ones following UARTBOOT_KEY, are seen by the protocol, and bytes
+// sent are not reordered with the output queued in the transmit ring.
+// Read from the receive ring into the buffer given by the argument ptr,
+// up to the byte amount given by the argument sz; return the byte amount read.
+static unsigned long uartboot_read (void *ptr, unsigned long sz) {
+	uart_pump (1);
+	return uartring_get (&uart_rxring, ptr, sz);
+}
+
+// Return non-null if UARTBOOT_KEY is among the bytes received.
+static unsigned long uartboot_haskey (void) {
+	unsigned char c;
+	uart_pump (1);
+	while (uartring_get (&uart_rxring, &c, 1))
+		if (c == UARTBOOT_KEY)
+			return 1;
+	return 0;
+}
+
+// Receive into the buffer given by the argument ptr, the byte amount
+// given by the argument sz, updating with it the crc32 given by the
+// argument crc; it is computed as bytes arrive to keep pace with the UART.
+// Return null if UARTBOOT_TIMEOUT elapsed without receiving a byte.
+static unsigned long uartboot_recv (void *ptr, unsigned long sz, uint32_t *crc) {
+	uint64_t t = ((hwdrvchar_dev.clkfreq/1000)*UARTBOOT_TIMEOUT);
+	uint64_t start = getclkcyclecnt().val;
+	while (sz) {
+		unsigned long n = uartboot_read (ptr, sz);
+		if (n) {
+			*crc = uartboot_crc32 (*crc, ptr, n);
+			ptr += n;
+			sz -= n;
+			start = getclkcyclecnt().val;
+		} else if ((getclkcyclecnt().val - start) >= t)
+			return 0;
+	}
+	return 1;
+}
+
+static void uartboot_send (void *ptr, unsigned long sz) {
+	while (sz) {
+		unsigned long n = uartring_put (&uart_txring, ptr, sz);
+		ptr += n;
+		sz -= n;
+		uart_flush();
+	}
+}
+
+static void uartboot_reply (unsigned char type, unsigned long seq) {
+	unsigned char r[5] = {type, seq, (seq>>8), ~seq, (~seq>>8)};
+	uartboot_send (r, sizeof(r));
+}
+
+// Receive the kernel through the UART, as described in uartboot.h,
+// writing it at KERNELADDR. Return its byte size.
+static unsigned long uartboot (void) {
+	unsigned long sz = 0, nframes = 0;
+	uint32_t imgcrc = 0;
+	unsigned char c = UARTBOOT_READY;
+	uartboot_send (&c, 1);
+	while (1) {
+		unsigned char hdr[UARTBOOT_HDRSZ], buf[8];
+		uint32_t crc;
+		// Look for the beginning of a frame; UARTBOOT_KEY received
+		// outside of a transfer gets answered, so that a host can
+		// restart after a failed transfer.
+		do {
+			while (!uartboot_read (hdr, 1));
+			if (hdr[0] == UARTBOOT_KEY && !sz)
+				uartboot_send (&c, 1);
+		} while (hdr[0] < UARTBOOT_HDR || hdr[0] > UARTBOOT_END);
+		crc = uartboot_crc32 (0, hdr, 1);
+		if (!uartboot_recv (&hdr[1], (UARTBOOT_HDRSZ-1), &crc))
+			continue;
+		unsigned long seq = (hdr[1] | (hdr[2] << 8));
+		unsigned long len = (hdr[3] | (hdr[4] << 8));
+		void *ptr = buf;
+		if (hdr[0] == UARTBOOT_DATA) {
+			if (seq >= nframes || len != ((seq == (nframes-1)) ?
+				(sz - (seq*UARTBOOT_FRAMESZ)) : UARTBOOT_FRAMESZ))
+				continue;
+			// The payload is received past the image, so that
+			// a damaged seq does not overwrite a frame already received.
+			ptr = ((void *)KERNELADDR + (nframes*UARTBOOT_FRAMESZ));
+		} else if (len != ((hdr[0] == UARTBOOT_HDR) ? 8 : 0))
+			continue;
+		if (!uartboot_recv (ptr, len, &crc) ||
+			!uartboot_recv (&hdr[1], 4, &(uint32_t){0}) ||
+			crc != (hdr[1] | (hdr[2] << 8) | (hdr[3] << 16) | ((uint32_t)hdr[4] << 24)))
+			continue;
+		if (hdr[0] == UARTBOOT_DATA)
+			memcpy ((void *)KERNELADDR + (seq*UARTBOOT_FRAMESZ), ptr, len);
+		else if (hdr[0] == UARTBOOT_HDR) {
+			unsigned long newsz = (buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((unsigned long)buf[3] << 24));
+			unsigned long newnframes = ((newsz + (UARTBOOT_FRAMESZ-1)) / UARTBOOT_FRAMESZ);
+			if (!newsz || newnframes > 0x10000 ||
+				!kernelramfits ((newnframes+1)*UARTBOOT_FRAMESZ)) {
+				uartboot_reply (UARTBOOT_NAK, seq);
+				continue;
+			}
+			sz = newsz;
+			nframes = newnframes;
+			imgcrc = (buf[4] | (buf[5] << 8) | (buf[6] << 16) | ((uint32_t)buf[7] << 24));
+			// Adjust %ksl to enable caching throughout the memory region where the kernel is to be loaded.
+			asm volatile ("setksl %0\n" :: "r"(KERNELADDR+((nframes+1)*UARTBOOT_FRAMESZ)));
+		} else if (!sz || uartboot_crc32 (0, (void *)KERNELADDR, sz) != imgcrc) {
+			uartboot_reply (UARTBOOT_NAK, seq);
+			sz = nframes = 0;
+			continue;
+		} else {
+			uartboot_reply ((hdr[0]^UARTBOOT_ACKMASK), seq);
+			return sz;
+		}
+		uartboot_reply ((hdr[0]^UARTBOOT_ACKMASK), seq);
+	}
+}
+
 #include <stdio.h>
 
 #define puts_hex(I) ({ \
@@ -256,11 +786,241 @@ __asm__ (
 	"___biosend: .ascii \"BIOSend=________\"\n"
 	".size    ___biosend, (. - ___biosend)\n");
 
+__asm__ (
+	".data\n"
+	".align "__xstr__(__SIZEOF_POINTER__)"\n"
+	".type ___uartbps, @object\n"
+	"___uartbps: .ascii \"UARTBPS=________\"\n"
+	".size    ___uartbps, (. - ___uartbps)\n");
+
+__asm__ (
+	".data\n"
+	".align "__xstr__(__SIZEOF_POINTER__)"\n"
+	".type ___hwdescr, @object\n"
+	"___hwdescr: .ascii \"HWDESCR=________\"\n"
+	".size    ___hwdescr, (. - ___hwdescr)\n");
+
+#include <hwdesc/hwdesc.h>
+
+// Serialize at the address given by the argument d the hardware description,
+// as described in hwdesc.h, without going past the address given by the argument end;
+// devices that do not fit get omitted.
+// Return the address following the blob, which is d if even hwdesc did not fit.
+static void *hwdesc_build (hwdesc *d, void *end) {
+	if ((void *)(d + 1) > end)
+		return d;
+	unsigned long v;
+	d->magic = HWDESC_MAGIC;
+	d->version = HWDESC_VERSION;
+	d->hdrsz = sizeof(hwdesc);
+	d->clkfreq = getclkfreq();
+	asm volatile ("geticachesize %0\n" : "=r"(v));
+	d->icachesz = v;
+	asm volatile ("getdcachesize %0\n" : "=r"(v));
+	d->dcachesz = v;
+	asm volatile ("gettlbsize %0\n" : "=r"(v));
+	d->tlbsz = v;
+	d->maxcorecnt = MAXCORECNT;
+	d->uartaddr = (unsigned long)hwdrvchar_dev.addr;
+	d->uartclkfreq = hwdrvchar_dev.clkfreq;
+	extern void *___uartbps;
+	d->uartbaud = *(unsigned long *)((void *)&___uartbps + 8/*sizeof("UARTBPS=")*/);
+	d->blkdevaddr = (unsigned long)hwdrvblkdev_dev.addr;
+	d->blkdevblkcnt = hwdrvblkdev_dev.blkcnt;
+	hwdrvdevtbl_ent *ram = hwdrvdevtbl_at ((void *)KERNELADDR);
+	d->ramaddr = (ram ? (unsigned long)ram->addr : 0);
+	d->ramsz = (ram ? (ram->mapsz*sizeof(unsigned long)) : 0);
+	hwdesc_dev *dev = (hwdesc_dev *)(d + 1);
+	for (v = 0; v < hwdrvdevtbl_idx.cnt && (void *)&dev[v+1] <= end; ++v) {
+		hwdrvdevtbl_ent *e = &hwdrvdevtbl_idx.e[v];
+		dev[v] = (hwdesc_dev){
+			.id = e->id, .addr = (unsigned long)e->addr,
+			.mapsz = e->mapsz, .intridx = e->intridx};
+	}
+	d->devcnt = v;
+	d->sz = ((void *)&dev[v] - (void *)d);
+	return &dev[v];
+}
+
+__asm__ (
+	".data\n"
+	".align "__xstr__(__SIZEOF_POINTER__)"\n"
+	".type ___parkmbx, @object\n"
+	"___parkmbx: .ascii \"PARKMBX=________\"\n"
+	".size    ___parkmbx, (. - ___parkmbx)\n");
+
+__asm__ (
+	".data\n"
+	".align "__xstr__(__SIZEOF_POINTER__)"\n"
+	".type ___ramzero, @object\n"
+	"___ramzero: .ascii \"RAMZERO=________\"\n"
+	".size    ___ramzero, (. - ___ramzero)\n");
+
+#if (RAMSCRUB > 0)
+
+#include <stdlib.h>
+
+// Sets cnt times (8*sizeof(unsigned long)) bytes of memory area dst to v,
+// using unrolled stores; dst must be aligned on sizeof(unsigned long).
+// Returns (dst+(cnt*8*sizeof(unsigned long))).
+void *uintset8 (void *dst, unsigned long v, unsigned long cnt); __asm__ (
+	".text\n"
+	".global  uintset8\n"
+	".type    uintset8, @function\n"
+	".p2align 1\n"
+	"uintset8:\n"
+
+	"jz %3, %rp\n"
+	"rli %sr, 0f; 0:\n"
+	"st %2, %1; inc8 %1, "__xstr__(__SIZEOF_POINTER__)"\n"
+	"st %2, %1; inc8 %1, "__xstr__(__SIZEOF_POINTER__)"\n"
+	"st %2, %1; inc8 %1, "__xstr__(__SIZEOF_POINTER__)"\n"
+	"st %2, %1; inc8 %1, "__xstr__(__SIZEOF_POINTER__)"\n"
+	"st %2, %1; inc8 %1, "__xstr__(__SIZEOF_POINTER__)"\n"
+	"st %2, %1; inc8 %1, "__xstr__(__SIZEOF_POINTER__)"\n"
+	"st %2, %1; inc8 %1, "__xstr__(__SIZEOF_POINTER__)"\n"
+	"st %2, %1; inc8 %1, "__xstr__(__SIZEOF_POINTER__)"\n"
+	"inc8 %3, -1\n"
+	"jnz %3, %sr\n"
+	"j %rp\n"
+
+	".size    uintset8, (. - uintset8)\n");
+
+// The RAM to scrub is split in chunks of RAMSCRUBCHUNKSZ bytes,
+// which the cores taking part claim one at a time, so that
+// a core which is slow to join does not delay the others.
+#define RAMSCRUBCHUNKSZ 0x10000
+static struct {
+	void *start, *end; // Region to scrub, with (end - start) a multiple of (8*sizeof(unsigned long)).
+	volatile unsigned long nxt; // Index of the next chunk to claim.
+	volatile unsigned long done; // Count of chunks scrubbed.
+	#if (MAXCORECNT > 1)
+	mutex m; // Lock to hold while using nxt or done.
+	#endif
+} ramscrub_ctx;
+
+// Scrub chunks until none is left to claim.
+static void ramscrub_work (void) {
+	while (1) {
+		#if (MAXCORECNT > 1)
+		mutex_lock (&ramscrub_ctx.m);
+		#endif
+		void *p = (ramscrub_ctx.start + (ramscrub_ctx.nxt++ * RAMSCRUBCHUNKSZ));
+		#if (MAXCORECNT > 1)
+		mutex_unlock (&ramscrub_ctx.m);
+		#endif
+		if (p >= ramscrub_ctx.end)
+			return;
+		void *e = (p + RAMSCRUBCHUNKSZ);
+		if (e > ramscrub_ctx.end)
+			e = ramscrub_ctx.end;
+		uintset8 (p, RAMSCRUBPATTERN, ((e - p) / (8*sizeof(unsigned long))));
+		#if (MAXCORECNT > 1)
+		mutex_lock (&ramscrub_ctx.m);
+		#endif
+		++ramscrub_ctx.done;
+		#if (MAXCORECNT > 1)
+		mutex_unlock (&ramscrub_ctx.m);
+		#endif
+	}
+}
+
+#if (MAXCORECNT > 1)
+// Posted to the mailbox of the parked cores by ramscrub().
+static void ramscrub_core (void *_) {
+	ramscrub_work();
+}
+#endif
+
+// Fill with RAMSCRUBPATTERN the RAM from the address given by the argument
+// start to the end of the RAM device containing it, splitting the work across
+// the cores, and report the throughput achieved.
+// Return the address from which RAM was scrubbed, or null if it was not.
+static void *ramscrub (void *start) {
+	hwdrvdevtbl_ent *ram = hwdrvdevtbl_at (start);
+	if (!ram || ram->id != 1 /* RAM device */)
+		return (void *)0;
+	void *end = (ram->addr + (ram->mapsz*sizeof(unsigned long)));
+	end -= ((unsigned long)(end - start) % (8*sizeof(unsigned long)));
+	if (end <= start)
+		return (void *)0;
+	ramscrub_ctx.start = start;
+	ramscrub_ctx.end = end;
+	unsigned long cnt = (((end - start) + (RAMSCRUBCHUNKSZ-1)) / RAMSCRUBCHUNKSZ);
+	uint64_t clkcnt = getclkcyclecnt().val;
+	#if (MAXCORECNT > 1)
+	// Have the parked cores join.
+	unsigned char posted[MAXCORECNT];
+	for (unsigned long i = 1; i < MAXCORECNT; ++i)
+		posted[i] = parkpu_post (i, ramscrub_core, (void *)0);
+	#endif
+	ramscrub_work();
+	while (ramscrub_ctx.done != cnt);
+	clkcnt = (getclkcyclecnt().val - clkcnt);
+	#if (MAXCORECNT > 1)
+	for (unsigned long i = 1; i < MAXCORECNT; ++i) {
+		if (!posted[i])
+			continue;
+		parkpu_wait (i);
+		puts("core "); puts_hex((uint8_t)i);
+		puts(" wake clk "); puts_hex(parkpu_mboxes[i].wakeclkcyclecnt); puts("\r\n");
+	}
+	#endif
+	char s[ITOA_BUFSZ];
+	unsigned long mbps = ((((uint64_t)(end - start) * getclkfreq()) / (clkcnt ? clkcnt : 1)) / 1000000);
+	puts("ram scrub "); puts(itoa(((end - start) >> 20), s, 10));
+	puts(" MiB "); puts(itoa((mbps / 1000), s, 10)); putchar('.');
+	putchar('0' + ((mbps / 100) % 10)); putchar('0' + ((mbps / 10) % 10)); putchar('0' + (mbps % 10));
+	puts(" GB/s\r\n");
+	return start;
+}
+
+#endif /* (RAMSCRUB > 0) */
+
 __attribute__((noreturn)) void main (void) {
 
 	clkcyclecnt startclkcyclecnt = getclkcyclecnt();
 
+	#ifdef LDRWARMBOOT
+	// Store the checksum of the read-only sections of the BIOS,
+	// which the loader checks on warm reset to skip reloading it.
+	extern void *_start, *__biosro_end;
+	extern unsigned long ___bioscsum[2];
+	unsigned long bioscsumsz = ((void *)&__biosro_end - ((void *)&_start + BIOSCSUMSTART));
+	___bioscsum[0] = bioscsum (((void *)&_start + BIOSCSUMSTART), bioscsumsz);
+	___bioscsum[1] = bioscsumsz;
+	#endif
+
+	// Index the device table so that lookups do not walk it.
+	hwdrvdevtbl_scan();
+
+	hwdrvblkdev_isbsy = coroutine_sched;
+	hwdrvchar_isbsy = coroutine_sched;
+
 	hwdrvchar_init (&hwdrvchar_dev, UARTBAUD);
+	hwdrvchar_rxmod_init (&uart_rxmod, (getclkfreq()/UARTRXBUDGET), (hwdrvchar_dev.bufsz/2));
+
+	// Save the UART baudrate, possibly negotiated with the host,
+	// to be retrieved from kernel environment.
+	extern void *___uartbps;
+	*(unsigned long *)((void *)&___uartbps + 8/*sizeof("UARTBPS=")*/) =
+	#if (BAUDNEGWAIT > 0)
+		baudneg (UARTBAUD);
+	#else
+		UARTBAUD;
+	#endif
+
+	coroutine_spawn (&uart_co, uart_cofn);
+
+	// Dispatch the UART receive interrupt while the BIOS boots.
+	intr_enabled = 1;
+	coroutine_spawn (&intr_co, intr_cofn);
+	hwdrvdevtbl_ent *uart = hwdrvdevtbl_at ((void *)UARTADDR);
+	if (uart && uart->intridx >= 0) {
+		hwdrvintctrl_sethdlr (uart->intridx, uart_intrhdlr, (void *)0);
+		uart_rxintrena = 1;
+		hwdrvchar_interrupt (&hwdrvchar_dev, uart_rxmod.threshold);
+	}
 
 	unsigned long socversion = 0;
 	__asm__ __volatile__ (
@@ -283,42 +1043,58 @@ __attribute__((noreturn)) void main (void) {
 
 	extern void *__executable_start, *_end;
 
-	// Save BIOS _end address to be retrieved from kernel environment.
-	extern void *___biosend;
-	*(unsigned long *)((void *)&___biosend + 8/*sizeof("BIOSend=")*/) = (unsigned long)&_end;
-
 	// Install parkpu() at the bottom of the bios region.
 	unsigned long parkpu_sz = ((unsigned long)&parkpu_end - (unsigned long)&parkpu);
 	if (parkpu_sz % sizeof(unsigned long)) { // parkpu() size must be appropriate for uintcpy().
 		puts("parkpu() has invalid size\r\n"); // ###: Can be commented out to reduce BIOS size.
+		uart_flush();
 		parkpu();
 	}
 	unsigned long parkpu_addr = (KERNELADDR - PARKPUSZ);
 	if ((unsigned long)&_end > parkpu_addr) {
 		puts("parkpu() cannot be installed\r\n"); // ###: Can be commented out to reduce BIOS size.
+		uart_flush();
 		parkpu();
 	}
 	uintcpy ((void *)parkpu_addr, &parkpu, parkpu_sz/sizeof(unsigned long));
+	#if (MAXCORECNT > 1)
+	parkpu_mboxinstall();
+	#endif
 
 	if (!hwdrvblkdev_init (&hwdrvblkdev_dev, 0)) {
 		puts("blkdev initialization failed\r\n");
+		uart_flush();
 		parkpu();
 	}
 
-	// Retrieve the kernel location from the MBR.
+	unsigned long kernelsz;
+
+	if (uartboot_rqst || uartboot_haskey()) {
+		puts("uart boot\r\n");
+		uart_flush();
+		kernelsz = uartboot();
+		goto kernelloaded;
+	}
+
+	// Retrieve the kernel location from the MBR, which is
+	// already presented in the window by hwdrvblkdev_init().
+	while (!(mbr = hwdrvblkdev_peek (&hwdrvblkdev_dev, 0, 0))) {
+		signed long isrdy;
+		while (!(isrdy = hwdrvblkdev_isrdy (&hwdrvblkdev_dev)));
+		if (isrdy < 0) {
+			puts("blkdev read error\r\n");
+			uart_flush();
+			parkpu();
+		}
+	}
 	unsigned long kernel_lba_begin = mbr->partition_entry[KERNPART].lba_begin;
 	unsigned long kernel_sect_cnt = mbr->partition_entry[KERNPART].sect_cnt;
+	hwdrvblkdev_release (&hwdrvblkdev_dev);
 	unsigned long kernel_lba_end = kernel_lba_begin + kernel_sect_cnt -1;
 
-	// Look for RAM device.
-	while (hwdrvdevtbl_find (&hwdrvdevtbl_ram, 0),
-		(hwdrvdevtbl_ram.mapsz && hwdrvdevtbl_ram.addr <= (void *)KERNELADDR)) {
-		if ((hwdrvdevtbl_ram.addr + (hwdrvdevtbl_ram.mapsz*sizeof(unsigned long))) >=
-			((void *)KERNELADDR + (kernel_sect_cnt*BLKSZ)))
-			break;
-	}
-	if (!hwdrvdevtbl_ram.mapsz || hwdrvdevtbl_ram.addr > (void *)KERNELADDR) {
+	if (!kernelramfits (kernel_sect_cnt*BLKSZ)) {
 		puts("no ram device large enough for kernel\r\n");
+		uart_flush();
 		parkpu();
 	}
 
@@ -326,19 +1102,19 @@ __attribute__((noreturn)) void main (void) {
 	asm volatile ("setksl %0\n" :: "r"(KERNELADDR+(((kernel_lba_end-kernel_lba_begin)+1)*BLKSZ)));
 
 	// Load kernel.
-	void *k = (void *)KERNELADDR;
-	for (unsigned long i = kernel_lba_begin; i <= kernel_lba_end;) {
-		signed long isrdy = hwdrvblkdev_isrdy (&hwdrvblkdev_dev);
-		if (isrdy < 0) {
-			puts("blkdev read error\r\n");
-			parkpu();
-		}
-		if (isrdy == 0)
-			continue;
-		unsigned long n = hwdrvblkdev_read (&hwdrvblkdev_dev, (void *)k, i, ((i + 1) <= kernel_lba_end));
-		k += (n*BLKSZ);
-		i += n;
+	static hwdrvblkdev_rqst kernel_rqst = {.op = HWDRVBLKDEV_READ};
+	kernel_rqst.ptr = (void *)KERNELADDR;
+	kernel_rqst.idx = kernel_lba_begin;
+	kernel_rqst.cnt = kernel_sect_cnt;
+	hwdrvblkdev_submit (&hwdrvblkdev_dev, &kernel_rqst);
+	if (hwdrvblkdev_wait (&hwdrvblkdev_dev, &kernel_rqst) != HWDRVBLKDEV_RQSTDONE) {
+		puts("blkdev read error\r\n");
+		uart_flush();
+		parkpu();
 	}
+	kernelsz = (kernel_sect_cnt*BLKSZ);
+
+	kernelloaded:;
 
 	uint64_t loadtime_clkcyclecnt = (getclkcyclecnt().val - startclkcyclecnt.val);
 	unsigned long loadtime = (loadtime_clkcyclecnt / getclkfreq());
@@ -351,12 +1127,49 @@ __attribute__((noreturn)) void main (void) {
 	hexdump ((void *)KERNELADDR, kernel_sect_cnt*BLKSZ);
 	#endif
 
+	// Scrub the RAM from the page following the kernel, and save to be retrieved
+	// from kernel environment the address from which RAM is pre-zeroed,
+	// so that the kernel can skip clearing pages past it; null if none is.
+	void *ramzero = (void *)0;
+	#if (RAMSCRUB > 0)
+	ramzero = ramscrub ((void *)((KERNELADDR + kernelsz + 0xfff) & ~0xfff));
+	if (RAMSCRUBPATTERN)
+		ramzero = (void *)0;
+	#else
+	(void)kernelsz; // Only used to scrub the RAM.
+	#endif
+	extern void *___ramzero;
+	*(unsigned long *)((void *)&___ramzero + 8/*sizeof("RAMZERO=")*/) = (unsigned long)ramzero;
+
+	// Serialize the hardware description right after the BIOS, and save its address
+	// to be retrieved from kernel environment; BIOSend accounts for it, so that
+	// the kernel preserves it along with the BIOS.
+	extern void *___hwdescr;
+	void *hwdesc_end = hwdesc_build ((hwdesc *)&_end, (void *)(KERNELADDR - PARKPUSZ));
+	*(unsigned long *)((void *)&___hwdescr + 8/*sizeof("HWDESCR=")*/) =
+		((hwdesc_end != (void *)&_end) ? (unsigned long)&_end : 0);
+
+	// Save the address of the mailboxes of the parked cores to be retrieved from kernel
+	// environment, so that the kernel can post functions to parked cores as parkpu_post()
+	// does, for instance to bring them up; null when the parked cores do not use them.
+	extern void *___parkmbx;
+	*(unsigned long *)((void *)&___parkmbx + 8/*sizeof("PARKMBX=")*/) =
+	#if (MAXCORECNT > 1)
+		(unsigned long)parkpu_mboxes;
+	#else
+		0;
+	#endif
+
+	// Save BIOS end address to be retrieved from kernel environment.
+	extern void *___biosend;
+	*(unsigned long *)((void *)&___biosend + 8/*sizeof("BIOSend=")*/) = (unsigned long)hwdesc_end;
+
 	// Setup the initial kernel stack as follow:
 	// - argc
 	// - null-terminated argv pointers array.
 	// - null-terminated envp pointers array.
 
-	volatile unsigned long p[7]; // Declared volatile so that GCC does not optimize it out.
+	volatile unsigned long p[11]; // Declared volatile so that GCC does not optimize it out.
 
 	p[0] = 2;
 	extern void *kernelarg_start;
@@ -365,7 +1178,38 @@ __attribute__((noreturn)) void main (void) {
 	p[3] = 0;
 	p[4] = (unsigned long)&___ishw;
 	p[5] = (unsigned long)&___biosend;
-	p[6] = 0;
+	p[6] = (unsigned long)&___uartbps;
+	p[7] = (unsigned long)&___hwdescr;
+	p[8] = (unsigned long)&___ramzero;
+	p[9] = (unsigned long)&___parkmbx;
+	p[10] = 0;
+
+	// Report the interrupts dispatched while the BIOS booted,
+	// then disable them, since they get delivered to the kernel.
+	for (unsigned long i = 0; i <= HWDRVINTCTRL_IPI; ++i) {
+		hwdrvintctrl_src *s = &hwdrvintctrl_srcs[i];
+		if (!s->cnt)
+			continue;
+		puts("intr "); puts_hex((uint8_t)i);
+		puts(" cnt "); puts_hex(s->cnt);
+		puts(" clk min "); puts_hex(s->latmin);
+		puts(" avg "); puts_hex((unsigned long)(s->lattotal / s->cnt));
+		puts(" max "); puts_hex(s->latmax);
+		puts("\r\n");
+	}
+	uart_rxintrena = 0;
+	hwdrvchar_interrupt (&hwdrvchar_dev, 0);
+	if (uart && uart->intridx >= 0)
+		hwdrvintctrl_sethdlr (uart->intridx, (void (*)(void *))0, (void *)0);
+	intr_enabled = 0;
+	hwdrvintctrl_drain (getcoreid());
+
+	uart_flush();
+
+	// The kernel may drive the UART directly, using the address
+	// and speed from hwdesc, hence the UART credits of this driver
+	// are no longer valid once the kernel is running.
+	hwdrvchar_dropcredits (&hwdrvchar_dev);
 
 	__asm__ __volatile__ (
 		"cpy %%sp, %0\n"
@@ -375,6 +1219,8 @@ __attribute__((noreturn)) void main (void) {
 		:: "r"(p), "r"(KERNELADDR)
 		: "memory");
 
+	hwdrvchar_dropcredits (&hwdrvchar_dev);
+	uart_flush();
 	parkpu();
 }
 
@@ -479,6 +1325,7 @@ typedef union {
 
 savedkctx * badopcode (savedkctx *kctx, unsigned long opcode) {
 	puts("badopcode: "); puts_hex(opcode); putchar(' '); puts_hex(opcode>>8); puts("\r\n");
+	uart_flush();
 	parkpu();
 	return kctx;
 }
@@ -691,6 +1538,147 @@ unsigned long hwdrvblkdev_blkoffs[MAXCORECNT] = {
 	[0 ... MAXCORECNT - 1] = 0,
 };
 
+// Block I/O scheduler used by the storage syscalls.
+// Each core has at most one request pending, since read() and write()
+// return 0 until the request transferring its blocks has completed.
+// When the block device is idle, pending requests are dispatched as
+// a single chain sorted by block index, beginning from where the previous
+// dispatch ended (C-SCAN), such that hwdrvblkdev_poll() pipelines adjacent
+// requests into runs; since every request queued is part of the next
+// dispatch, a request waits at most for the chain in progress.
+
+#define BLKSCHED_FREE		0
+#define BLKSCHED_QUEUED		1
+#define BLKSCHED_DISPATCHED	2
+
+struct {
+	hwdrvblkdev_rqst rqst;
+	// Block count requested, before it got clamped to the block device size.
+	unsigned long cnt;
+	// BLKSCHED_FREE, BLKSCHED_QUEUED or BLKSCHED_DISPATCHED.
+	unsigned long state;
+} blksched_slot[MAXCORECNT];
+
+// Block index following the last request dispatched.
+unsigned long blksched_pos = 0;
+
+// Return the chain of queued requests to dispatch, or null.
+static hwdrvblkdev_rqst *blksched_chain (void) {
+	hwdrvblkdev_rqst *chain = (void *)0, **tail = &chain;
+	void append (unsigned long i) {
+		blksched_slot[i].state = BLKSCHED_DISPATCHED;
+		blksched_slot[i].rqst.nxt = (void *)0;
+		*tail = &blksched_slot[i].rqst;
+		tail = &blksched_slot[i].rqst.nxt;
+		blksched_pos = (blksched_slot[i].rqst.idx + blksched_slot[i].rqst.cnt);
+	}
+	unsigned long i, j;
+	// Sweep through the requests in ascending block index order
+	// from blksched_pos, wrapping around to the lowest block index.
+	while (1) {
+		unsigned long k = -1;
+		for (i = 0, j = -1; i < MAXCORECNT; ++i) {
+			if (blksched_slot[i].state != BLKSCHED_QUEUED)
+				continue;
+			unsigned long idx = blksched_slot[i].rqst.idx;
+			if (idx >= blksched_pos && (j == -1 || idx < blksched_slot[j].rqst.idx))
+				j = i;
+			if (k == -1 || idx < blksched_slot[k].rqst.idx)
+				k = i;
+		}
+		if (j != -1)
+			append (j);
+		else if (k != -1)
+			append (k);
+		else
+			break;
+	}
+	return chain;
+}
+
+// Advance the requests dispatched, dispatching queued
+// requests when the block device becomes idle.
+static void blksched_step (void) {
+	signed long ret = hwdrvblkdev_poll (&hwdrvblkdev_dev);
+	if (ret > 0) {
+		hwdrvblkdev_rqst *chain = blksched_chain();
+		if (chain) {
+			hwdrvblkdev_submit (&hwdrvblkdev_dev, chain);
+			if (chain->status == HWDRVBLKDEV_RQSTERROR)
+				ret = -1;
+		}
+	}
+	// Requests dispatched have failed; they get
+	// reported by blksched_rw() to their core.
+	if (ret < 0) {
+		if (!hwdrvblkdev_init (&hwdrvblkdev_dev, 0)) {
+			//puts("blkdev initialization failed\r\n");
+		}
+	}
+}
+
+// Transfer for the calling core, cnt blocks between the buffer
+// given by the argument ptr and the core's block offset, where the
+// argument op is either HWDRVBLKDEV_READ or HWDRVBLKDEV_WRITE.
+// Returns the count of blocks transferred, 0 if the transfer is still
+// pending and the call must be repeated with the same arguments,
+// or -1 on error.
+// The buffer of a pending request gets transferred asynchronously, from within
+// the storage syscalls of any core, hence it must be left untouched until
+// the call returns non-zero.
+// A call whose arguments differ from the ones of the pending request,
+// for instance following an lseek() or using another buffer, restarts
+// the request; a request already dispatched cannot be recalled, hence
+// its completion gets waited for, and its result discarded.
+static signed long blksched_rw (unsigned long op, void *ptr, unsigned long cnt) {
+	unsigned long coreid = getcoreid();
+	typeof(blksched_slot[0]) *slot = &blksched_slot[coreid];
+	signed long ret = 0;
+	#if (MAXCORECNT > 1)
+	static mutex m = {0, 0, 0};
+	mutex_lock (&m); // Done for multicore support.
+	#endif
+	unsigned long idx = hwdrvblkdev_blkoffs[coreid];
+	unsigned long stale = (slot->state != BLKSCHED_FREE && (
+		slot->rqst.ptr != ptr || slot->rqst.op != op ||
+		slot->rqst.idx != idx || slot->cnt != cnt));
+	if (stale && slot->state == BLKSCHED_QUEUED)
+		slot->state = BLKSCHED_FREE;
+	if (slot->state == BLKSCHED_FREE) {
+		if (idx >= hwdrvblkdev_dev.blkcnt) {
+			ret = -1;
+			goto done;
+		}
+		slot->cnt = cnt;
+		if (cnt > (hwdrvblkdev_dev.blkcnt - idx))
+			cnt = (hwdrvblkdev_dev.blkcnt - idx);
+		slot->rqst.ptr = ptr;
+		slot->rqst.idx = idx;
+		slot->rqst.cnt = cnt;
+		slot->rqst.op = op;
+		slot->rqst.status = HWDRVBLKDEV_RQSTQUEUED;
+		slot->state = BLKSCHED_QUEUED;
+		stale = 0;
+	}
+	blksched_step();
+	if (slot->state == BLKSCHED_DISPATCHED && slot->rqst.status != HWDRVBLKDEV_RQSTQUEUED) {
+		// The result of a stale request is discarded, and
+		// the next call of the caller queues its request.
+		if (!stale) {
+			if (slot->rqst.status == HWDRVBLKDEV_RQSTDONE)
+				hwdrvblkdev_blkoffs[coreid] += (ret = slot->rqst.cnt);
+			else
+				ret = -1;
+		}
+		slot->state = BLKSCHED_FREE;
+	}
+	done:
+	#if (MAXCORECNT > 1)
+	mutex_unlock (&m);
+	#endif
+	return ret;
+}
+
 savedkctx * syscallhdlr (savedkctx *kctx, unsigned long _) {
 
 	unsigned long sr; // %sr: syscall number.
@@ -703,6 +1691,10 @@ savedkctx * syscallhdlr (savedkctx *kctx, unsigned long _) {
 	else
 		__asm__ __volatile__ ("setkgpr %0, %%sr\n" : "=r"(sr));
 
+	// The kernel may have used the UART since the previous syscall.
+	hwdrvchar_dropcredits (&hwdrvchar_dev);
+	uart_service();
+
 	switch (sr) {
 
 		case __NR_lseek: { // off_t lseek (int fd, off_t offset, int whence);
@@ -760,43 +1752,23 @@ savedkctx * syscallhdlr (savedkctx *kctx, unsigned long _) {
 
 			if (r1 == BIOS_FD_STDIN) {
 				#if (MAXCORECNT > 1)
-				static mutex m = {0, 0, 0};
-				mutex_lock (&m); // Done for multicore support.
+				mutex_lock (&uart_mutex); // Done for multicore support.
 				#endif
-				r1 = hwdrvchar_read (&hwdrvchar_dev, (unsigned char *)r2, r3);
+				uart_pump (1);
+				r1 = uartring_get (&uart_rxring, (unsigned char *)r2, r3);
 				#if (MAXCORECNT > 1)
-				mutex_unlock (&m);
+				mutex_unlock (&uart_mutex);
 				#endif
 			} else if (r1 == BIOS_FD_STORAGEDEV) {
-				if (r3 == 0) {
-					r1 = 0;
-					goto done;
-				}
-				#if (MAXCORECNT > 1)
-				static mutex m = {0, 0, 0};
-				mutex_lock (&m); // Done for multicore support.
-				#endif
-				if (hwdrvblkdev_blkoffs[getcoreid()] >= hwdrvblkdev_dev.blkcnt)
+				if (getcoreid() >= MAXCORECNT)
 					goto error;
-				signed long isrdy = hwdrvblkdev_isrdy (&hwdrvblkdev_dev);
-				if (isrdy < 0 &&
-					!hwdrvblkdev_init (&hwdrvblkdev_dev, 0)) {
-					//puts("blkdev initialization failed\r\n");
-					//puts("blkdev read error\r\n");
-					goto error;
-				}
-				if (isrdy == 0) {
+				if (r3 == 0) {
 					r1 = 0;
 					goto done;
 				}
-				hwdrvblkdev_blkoffs[getcoreid()] +=
-					(r1 = hwdrvblkdev_read (
-						&hwdrvblkdev_dev, (void *)r2, hwdrvblkdev_blkoffs[getcoreid()], (r3 > 1)));
+				r1 = blksched_rw (HWDRVBLKDEV_READ, (void *)r2, r3);
 				// Note that return value is not byte amount
 				// but number of blocks read.
-				#if (MAXCORECNT > 1)
-				mutex_unlock (&m);
-				#endif
 			} else
 				goto error;
 
@@ -820,43 +1792,26 @@ savedkctx * syscallhdlr (savedkctx *kctx, unsigned long _) {
 
 			if (r1 == BIOS_FD_STDOUT || r1 == BIOS_FD_STDERR) {
 				#if (MAXCORECNT > 1)
-				static mutex m = {0, 0, 0};
-				mutex_lock (&m); // Done for multicore support.
+				mutex_lock (&uart_mutex); // Done for multicore support.
 				#endif
-				r1 = hwdrvchar_write (&hwdrvchar_dev, (unsigned char *)r2, r3);
+				r1 = uartring_put (&uart_txring, (unsigned char *)r2, r3);
+				// Flushed before returning, since no later syscall may
+				// come to pump it, and since the kernel may write to
+				// the UART directly, after this output.
+				uart_flush();
 				#if (MAXCORECNT > 1)
-				mutex_unlock (&m);
+				mutex_unlock (&uart_mutex);
 				#endif
 			} else if (r1 == BIOS_FD_STORAGEDEV) {
-				if (r3 == 0) {
-					r1 = 0;
-					goto done;
-				}
-				#if (MAXCORECNT > 1)
-				static mutex m = {0, 0, 0};
-				mutex_lock (&m); // Done for multicore support.
-				#endif
-				if (hwdrvblkdev_blkoffs[getcoreid()] >= hwdrvblkdev_dev.blkcnt)
-					goto error;
-				signed long isrdy = hwdrvblkdev_isrdy (&hwdrvblkdev_dev);
-				if (isrdy < 0 &&
-					!hwdrvblkdev_init (&hwdrvblkdev_dev, 0)) {
-					//puts("blkdev initialization failed\r\n");
-					//puts("blkdev write error\r\n");
+				if (getcoreid() >= MAXCORECNT)
 					goto error;
-				}
-				if (isrdy == 0) {
+				if (r3 == 0) {
 					r1 = 0;
 					goto done;
 				}
-				hwdrvblkdev_write (&hwdrvblkdev_dev, (void *)r2, hwdrvblkdev_blkoffs[getcoreid()], (r3 > 1));
-				hwdrvblkdev_blkoffs[getcoreid()] += 1;
-				r1 = 1;
+				r1 = blksched_rw (HWDRVBLKDEV_WRITE, (void *)r2, r3);
 				// Note that return value is not byte amount
 				// but number of blocks written.
-				#if (MAXCORECNT > 1)
-				mutex_unlock (&m);
-				#endif
 			} else
 				goto error;
 
@@ -872,6 +1827,9 @@ savedkctx * syscallhdlr (savedkctx *kctx, unsigned long _) {
 			else
 				__asm__ __volatile__ ("setkgpr %0, %%1\n" : "=r"(r1));
 
+			// Output still in the transmit ring would be lost by the reset.
+			uart_flush();
+
 			__asm__ __volatile__ (
 				"ldst %0, %1"
 				: "+r" (r1)
@@ -1,15 +1,26 @@
 // SPDX-License-Identifier: GPL-2.0-only
 // (c) William Fonkou Tambe
 
-#define STACKSZ		256 /* computed from -fstack-usage outputs and sizeof(savedkctx) */
+// STACKSZ is computed from -fstack-usage outputs and sizeof(savedkctx); the worst chain
+// is a syscall from the kernel still on its initial stack within the frame of main(),
+// hence main() + savedkctx + syscallhdlr() -> blksched_rw() -> hwdrvblkdev_poll()
+// -> coroutine_sched() -> uart_service() -> uart_pump() -> hwdrvchar_write(),
+// about 720 bytes; main() alone, which includes its p[] and the kernel load, needs about 510.
+#define STACKSZ		768
 #define UARTADDR	(0x0ff8 /* By convention, the first UART is located at 0x0ff8 */)
 #define UARTBAUD	115200
+#define BAUDNEGWAIT	50 /* ms waited at boot for a host to request a faster baudrate; 0 disables it */
 #define BLKDEVADDR	(0x0 /* By convention, the first block device is located at 0x0 */)
 #define DEVTBLADDR	(0x200 /* By convention, the device table is located at 0x200 */)
 #define RAMDEVADDR	(0x1000 /* By convention, the first RAM device is located at 0x1000 */)
 #define KERNELADDR	0x8000 /* must match corresponding constant in the kernel source-code */
 #define KERNPART	2
+#define BIOSPART	1 /* must match corresponding constant in loader.h */
 #define CLDSTMUTEXCNT	8 /* the greater this value, the least likely threads will contend */
+#define UARTRINGSZ	256 /* must be a power of two */
+#define UARTRXBUDGET	1000 /* 1/UARTRXBUDGET seconds that a received byte is allowed to wait */
+#define RAMSCRUB	0 /* optional; when 1, fill the RAM past the kernel with RAMSCRUBPATTERN at boot */
+#define RAMSCRUBPATTERN	0 /* the kernel is told that RAM is pre-zeroed only when null */
 
 #define MAXCORECNT 1
 
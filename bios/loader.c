@@ -124,8 +124,27 @@ extern void* _end;
 
 unsigned long saved_sp __attribute__((used));
 
+#include "warmboot.h"
+
 __attribute__((noreturn)) void main (void) {
 	unsigned v;
+	#ifdef LDRWARMBOOT
+	// When the BIOS left in memory by a previous boot is intact,
+	// as checked against the checksum that it stored, and was loaded
+	// from the BIOS partition that the MBR, still presented at BLKDEVADDR,
+	// describes, jump to it without initializing memory nor reloading the BIOS.
+	// A BIOS partition rewritten in place without changing its extents
+	// is not detected, and gets loaded only on the next cold boot.
+	v = ((unsigned long *)(BIOSADDR+BIOSCSUMOFFS))[1];
+	if (v && v < (KERNELADDR-BIOSADDR) &&
+		((uint32_t *)(BIOSADDR+BIOSPARTOFFS))[0] ==
+		((mbr_t *)(BLKDEVADDR))->partition_entry[BIOSPART].lba_begin &&
+		((uint32_t *)(BIOSADDR+BIOSPARTOFFS))[1] ==
+		((mbr_t *)(BLKDEVADDR))->partition_entry[BIOSPART].sect_cnt &&
+		bioscsum ((unsigned long *)(BIOSADDR+BIOSCSUMSTART), v) ==
+		((unsigned long *)(BIOSADDR+BIOSCSUMOFFS))[0])
+		goto *(void *)BIOSADDR;
+	#endif
 	#define LDRMEMINIT
 	#ifdef LDRMEMINIT
 	// Initialize and test memory.
@@ -195,6 +214,10 @@ __attribute__((noreturn)) void main (void) {
 		blkdev_read(bios_lba_begin);
 		v = (unsigned long)uintcpy ((void *)v, BLKDEVADDR, BLKSZ/sizeof(unsigned long));
 	}
+	#ifdef LDRWARMBOOT
+	((uint32_t *)(BIOSADDR+BIOSPARTOFFS))[0] = ((bios_lba_end + 1) - bios_sect_cnt);
+	((uint32_t *)(BIOSADDR+BIOSPARTOFFS))[1] = bios_sect_cnt;
+	#endif
 	// Jump to loaded BIOS.
 	goto *(void *)BIOSADDR;
 }
@@ -1,7 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0-only
 // (c) William Fonkou Tambe
 
-#define STACKSZ         16 /* computed from -fstack-usage outputs */
+#define STACKSZ         16 /* computed from -fstack-usage outputs; re-check when enabling LDRWARMBOOT in warmboot.h */
 #define BLKDEVADDR      (0x0 /* By convention, the first block device is located at 0x0 */)
 #define DEVTBLADDR      (0x200 /* By convention, the device table is located at 0x200 */)
 #define BIOSADDR        0x1000
@@ -0,0 +1,41 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// (c) William Fonkou Tambe
+
+#ifndef WARMBOOT_H
+#define WARMBOOT_H
+
+// When defined, the loader jumps to the BIOS left in memory by a previous boot
+// when it is intact, instead of initializing memory and reloading the BIOS,
+// and the BIOS carries what is needed for it; it is shared by loader.c and bios.c.
+// Optional, since it grows the loader; enable only after checking the section sizes
+// printed by the makefile, as the link fails when the loader exceeds its budget.
+//#define LDRWARMBOOT
+
+// The BIOS stores at BIOSCSUMOFFS from its start, its checksum followed by the
+// byte size that it covers from BIOSCSUMSTART, which the loader checks on warm
+// reset to skip reloading the BIOS; the checksum is null until the BIOS stores it.
+// It is followed at BIOSPARTOFFS by the lba_begin and sect_cnt, as uint32_t,
+// of the partition that the loader loaded the BIOS from, which the loader stores
+// after loading it, and checks against the MBR on warm reset, so that a BIOS
+// partition that got moved or resized gets reloaded.
+#define BIOSCSUMOFFS	8
+#define BIOSPARTOFFS	(BIOSCSUMOFFS + (2*__SIZEOF_POINTER__))
+#define BIOSCSUMSTART	32
+
+// Compute the checksum of the memory at the address given by the argument p,
+// covering the byte amount given by the argument n, which must be a multiple
+// of (4*sizeof(unsigned long)); b accumulates a, so that the order of words matters.
+static inline __attribute__((always_inline)) unsigned long bioscsum (unsigned long *p, unsigned long n) {
+	unsigned long *e = ((void *)p + n);
+	unsigned long a = 0, b = 0;
+	while (p < e) {
+		b += (a += p[0]);
+		b += (a += p[1]);
+		b += (a += p[2]);
+		b += (a += p[3]);
+		p += 4;
+	}
+	return (a ^ b);
+}
+
+#endif /* WARMBOOT_H */
@@ -0,0 +1,389 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// (c) William Fonkou Tambe
+
+// Benchmark of the block device through hwdrvblkdev.h,
+// reporting over the UART the IOPS, throughput and latency
+// histogram of sequential and random reads and writes,
+// and comparing nxt-pipelined against non-pipelined reads.
+// Write tests rewrite blocks with the data they held, anywhere on the
+// block device including the MBR and the BIOS partition, such that
+// an interrupted run can leave the image unbootable; they are
+// disabled by default, and enabled by setting BLKBENCHWRITE non-null.
+
+// Use as kernel:
+// sudo /opt/pu32-toolchain/bin/pu32-mksocimg -k blkbench.bin blkbench.img
+
+// Used to stringify.
+#define __xstr__(s) __str__(s)
+#define __str__(s) #s
+
+static unsigned char stack[STACKSZ] __attribute__((used));
+
+// Substitute for crt0.S since this is built using -nostdlib.
+__asm__ (
+	".section .text._start\n"
+	".global  _start\n"
+	".type    _start, @function\n"
+	".p2align 1\n"
+	"_start:\n"
+
+	// Disable timer and external interrupts; enable instruction getclkcyclecnt.
+	"li %sr, (0x10 | 0x1000 | 0x2000)\n"
+	"setflags %sr\n"
+	"li %sr, 0x1000\n"
+	"setksl %sr\n"
+
+	// Clear all TLB entries.
+	"gettlbsize %1\n"
+	"li %2, 12\n"
+	"sll %1, %2\n"
+	"li %3, 0\n"
+	"li %2, (1<<12)\n"
+	"0: sub %1, %2\n"
+	"clrtlb %3, %1\n"
+	"rli %sr, 0b\n"
+	"jnz %1, %sr\n"
+	"li %sr, 0\n" // %sr is expected to have the address of the Page-Global-Directory.
+	// Re-using %2 value to set userspace asid.
+	"setasid %2\n"
+
+	// Continue execution in usermode.
+	"rli %sr, 1f\n"
+	"setuip %sr\n"
+	"0: sysret\n"
+
+	//#define DEBUG_KERNELMODE
+
+	#ifdef DEBUG_KERNELMODE
+	#define HWDRVCHAR_CMDGETBUFFERUSAGE 0
+	"80: li %2, "__xstr__(UARTADDR)"\n"
+	"li %1, "__xstr__((HWDRVCHAR_CMDGETBUFFERUSAGE<<30) | 1)"\n"
+	"ldst %1, %2\n"
+	"rli %sr, 80b; jnz %1, %sr\n"
+	"li8 %1, '+'; st %1, %2\n"
+	//"li8 %1, '\n'; st %1, %2\n"
+	#endif
+
+	// Assumption is that the interrupt
+	// is always occurring only for:
+	// ReadFaultIntr WriteFaultIntr ExecFaultIntr.
+
+	"getfaultreason %1\n"
+	"li %2, 2\n" // ExecFaultIntr.
+	"li %3, 0b10001\n" // user::::executable:
+	"seq %1, %2; rli %sr, 10f; jnz %1, %sr\n"
+	"li %3, 0b10110; 10:\n" // user::readable:writable::
+
+	"getfaultaddr %1\n"
+
+	"li %2, 0xfff\n"
+	"li %4, 3\n"
+	"not %5, %2\n"
+
+	"and %1, %5\n"
+	"cpy %6, %1\n"
+	"or %6, %3\n"
+	// Enable caching if page is not at address 0.
+	"cpy %7, %1\n"
+	"slte %7, %2\n"
+	"sll %7, %4\n"
+	"or %6, %7\n"
+
+	"settlb %6, %1\n"
+
+	#ifdef DEBUG_KERNELMODE
+	"80: li %2, "__xstr__(UARTADDR)"\n"
+	"li %1, "__xstr__((HWDRVCHAR_CMDGETBUFFERUSAGE<<30) | 1)"\n"
+	"ldst %1, %2\n"
+	"rli %sr, 80b; jnz %1, %sr\n"
+	"li8 %1, '-'; st %1, %2\n"
+	//"li8 %1, '\n'; st %1, %2\n"
+	#endif
+
+	"rli %sr, 0b; j %sr; 1:\n"
+
+	// Initialize %sp and %fp.
+	"rli %sp, stack + "__xstr__(STACKSZ)"\n"
+	"li8 %fp, 0\n"
+	#if 0 // ### Disabled, as section .bss is loaded in memory having been already zeroed.
+	// Zero section .bss .
+	"rli %8, __bss_start\n"
+	"rli %9, __bss_end\n"
+	"li8 %10, 0\n"
+	"rli %11, 0f\n"
+	"rli %12, 1f\n"
+	"0: cpy %13, %8\n"
+	"sltu %13, %9\n"
+	"jz %13, %12\n"
+	"st %10, %8\n" // Write zero.
+	"inc8 %8, "__xstr__(__SIZEOF_POINTER__)"\n"
+	"j %11; 1:\n"
+	#endif
+	// Call main().
+	"rli %sr, main\n"
+	"jl %rp, %sr\n"
+	// We should never return from above jl,
+	// otherwise we must infinite loop.
+	"j %rp\n"
+
+	".size    _start, (. - _start)\n");
+
+#include <hwdrvchar/hwdrvchar.h>
+hwdrvchar hwdrvchar_dev = {.addr = (void *)UARTADDR};
+
+#include <cons/cons.h>
+cons cons_dev = {.dev = &hwdrvchar_dev};
+
+int putchar (int c) {
+	cons_putc (&cons_dev, c);
+	return c;
+}
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+static void puts_dec (unsigned long n) {
+	char s[ITOA_BUFSZ];
+	puts(itoa(n, s, 10));
+}
+
+// Copies cnt uints from memory area src to memory area dst.
+// The memory areas must not overlap.
+// Returns (dst+(cnt*sizeof(unsigned long))).
+void *uintcpy (void *dst, const void *src, unsigned long cnt); __asm__ (
+	".text\n"
+	".global  uintcpy\n"
+	".type    uintcpy, @function\n"
+	".p2align 1\n"
+	"uintcpy:\n"
+
+	"jz %3, %rp\n"
+	"rli %sr, 0f; 0:\n"
+	"ld %4, %2\n"
+	"inc8 %2, "__xstr__(__SIZEOF_POINTER__)"\n"
+	"st %4, %1\n"
+	"inc8 %1, "__xstr__(__SIZEOF_POINTER__)"\n"
+	"inc8 %3, -1\n"
+	"jnz %3, %sr\n"
+	"j %rp\n"
+
+	".size    uintcpy, (. - uintcpy)\n");
+
+typedef unsigned long size_t;
+
+// hwdrvblkdev.h only copies whole aligned blocks.
+void *memcpy (void *dst, const void *src, size_t cnt) {
+	uintcpy (dst, src, (cnt/sizeof(unsigned long)));
+	return dst;
+}
+
+typedef union {
+	struct {
+		unsigned long lo, hi;
+	};
+	uint64_t val;
+} clkcyclecnt;
+
+clkcyclecnt getclkcyclecnt (void) {
+	inline unsigned long getclkcyclecnthi (void) {
+		unsigned long hi;
+		asm volatile ("getclkcyclecnth %0\n" : "=r"(hi));
+		return hi;
+	}
+	clkcyclecnt ret;
+	do {
+		ret.hi = getclkcyclecnthi();
+		asm volatile ("getclkcyclecnt %0\n"  : "=r"(ret.lo));
+	} while (ret.hi != getclkcyclecnthi());
+	return ret;
+}
+
+#include <hwdrvblkdev/hwdrvblkdev.h>
+hwdrvblkdev hwdrvblkdev_dev = {.addr = (void *)BLKDEVADDR};
+
+static unsigned char buf[BLKBENCHBATCH*BLKSZ] __attribute__((aligned(sizeof(unsigned long))));
+
+// Pseudo-random number generator (xorshift32).
+static unsigned long rng (void) {
+	static uint32_t x = 2463534242;
+	x ^= (x << 13);
+	x ^= (x >> 17);
+	x ^= (x << 5);
+	return x;
+}
+
+// Latency histogram of the test in progress, where hist[i]
+// counts the operations having taken from 2^i to (2^(i+1))-1 us.
+static unsigned long hist[8*__SIZEOF_POINTER__];
+static unsigned long long latmin, latmax, lattotal;
+// Count of the operations accounted with histadd().
+static unsigned long latcnt;
+static unsigned long errcnt;
+
+static void histreset (void) {
+	for (unsigned long i = 0; i < (sizeof(hist)/sizeof(hist[0])); ++i)
+		hist[i] = 0;
+	latmin = -1;
+	latmax = 0;
+	lattotal = 0;
+	latcnt = 0;
+}
+
+// Account an operation having taken the clock cycles given by the argument cycles.
+static void histadd (unsigned long long cycles) {
+	if (cycles < latmin)
+		latmin = cycles;
+	if (cycles > latmax)
+		latmax = cycles;
+	lattotal += cycles;
+	++latcnt;
+	unsigned long us = ((cycles * 1000000) / hwdrvblkdev_clkfreq());
+	unsigned long i = 0;
+	while (us >>= 1)
+		++i;
+	++hist[i];
+}
+
+// Transfer cnt blocks between buf and the block device, from
+// the block index idx, re-initializing the device on error.
+// Returns 1 on success, otherwise 0.
+static unsigned long xfer (unsigned long op, unsigned long idx, unsigned long cnt) {
+	hwdrvblkdev_rqst rqst = {.nxt = 0, .ptr = buf, .idx = idx, .cnt = cnt, .op = op};
+	hwdrvblkdev_submit (&hwdrvblkdev_dev, &rqst);
+	if (hwdrvblkdev_wait (&hwdrvblkdev_dev, &rqst) == HWDRVBLKDEV_RQSTDONE)
+		return 1;
+	++errcnt;
+	puts("! blkdev error at block "); puts_dec(idx); putchar('\n');
+	hwdrvblkdev_init (&hwdrvblkdev_dev, 0);
+	return 0;
+}
+
+// Read cnt blocks from the block index idx using hwdrvblkdev_read(),
+// with or without initiating the next block read while retrieving
+// the block read, as selected by the argument nxt; the clock cycles
+// between blocks retrieved get accounted with histadd().
+// Returns 1 on success, otherwise 0.
+static unsigned long readlegacy (unsigned long idx, unsigned long cnt, unsigned long nxt) {
+	unsigned long long t = getclkcyclecnt().val;
+	for (unsigned long i = 0; i < cnt;) {
+		signed long isrdy = hwdrvblkdev_isrdy (&hwdrvblkdev_dev);
+		if (isrdy < 0) {
+			++errcnt;
+			puts("! blkdev error at block "); puts_dec(idx+i); putchar('\n');
+			hwdrvblkdev_init (&hwdrvblkdev_dev, 0);
+			return 0;
+		}
+		if (!isrdy)
+			continue;
+		unsigned long j = (i%BLKBENCHBATCH);
+		// The next block read is resumed at the following buffer location,
+		// hence not initiated when buf wraps around.
+		if (hwdrvblkdev_read (&hwdrvblkdev_dev, buf+(j*BLKSZ), idx+i,
+			(nxt && (i+1) < cnt && (j+1) < BLKBENCHBATCH))) {
+			unsigned long long now = getclkcyclecnt().val;
+			histadd (now - t);
+			t = now;
+			++i;
+		}
+	}
+	return 1;
+}
+
+// Print the results of a test having successfully done opcnt operations
+// of blkperop blocks each, in the clock cycles given by the argument cycles.
+static void report (char *name, unsigned long opcnt, unsigned long blkperop, unsigned long long cycles) {
+	unsigned long long freq = hwdrvblkdev_clkfreq();
+	if (!cycles)
+		cycles = 1;
+	puts(name);
+	if (!opcnt) {
+		puts(": no operation succeeded\n");
+		return;
+	}
+	puts(": iops "); puts_dec((opcnt * freq) / cycles);
+	puts(" KB/s "); puts_dec((((unsigned long long)opcnt * blkperop * BLKSZ * freq) / 1024) / cycles);
+	puts(" us min "); puts_dec((latmin * 1000000) / freq);
+	puts(" avg "); puts_dec(((lattotal / opcnt) * 1000000) / freq);
+	puts(" max "); puts_dec((latmax * 1000000) / freq);
+	putchar('\n');
+	for (unsigned long i = 0; i < (sizeof(hist)/sizeof(hist[0])); ++i) {
+		if (!hist[i])
+			continue;
+		puts("  us < "); puts_dec(2 << i);
+		puts(": "); puts_dec(hist[i]);
+		putchar('\n');
+	}
+}
+
+#define SEQ	0
+#define RAND	1
+
+// Run a test of BLKBENCHOPCNT operations of blkperop blocks
+// each, where op is either HWDRVBLKDEV_READ or HWDRVBLKDEV_WRITE,
+// and pattern is either SEQ or RAND.
+static void runtest (char *name, unsigned long op, unsigned long pattern, unsigned long blkperop) {
+	unsigned long blkcnt = hwdrvblkdev_dev.blkcnt;
+	histreset();
+	unsigned long long cycles = 0;
+	for (unsigned long i = 0; i < BLKBENCHOPCNT; ++i) {
+		unsigned long idx = ((pattern == RAND) ?
+			(rng() % (blkcnt - blkperop)) :
+			((i * blkperop) % (blkcnt - blkperop)));
+		// Blocks get rewritten with the data they held.
+		if (op == HWDRVBLKDEV_WRITE && !xfer (HWDRVBLKDEV_READ, idx, blkperop))
+			continue;
+		unsigned long long t = getclkcyclecnt().val;
+		unsigned long ret = xfer (op, idx, blkperop);
+		t = (getclkcyclecnt().val - t);
+		if (ret) {
+			histadd (t);
+			cycles += t;
+		}
+	}
+	report (name, latcnt, blkperop, cycles);
+}
+
+// Compare sequential reads of BLKBENCHOPCNT blocks
+// with and without initiating the next block read.
+static void runnxt (void) {
+	for (unsigned long nxt = 0; nxt < 2; ++nxt) {
+		histreset();
+		unsigned long long t = getclkcyclecnt().val;
+		readlegacy (0, BLKBENCHOPCNT, nxt);
+		t = (getclkcyclecnt().val - t);
+		report ((nxt ? "seq read nxt" : "seq read !nxt"), latcnt, 1, t);
+	}
+}
+
+void main (void) {
+	hwdrvchar_init (&hwdrvchar_dev, UARTBAUD);
+	puts("blkbench\n");
+	if (!hwdrvblkdev_init (&hwdrvblkdev_dev, 0)) {
+		puts("! blkdev initialization failed\n");
+		return;
+	}
+	puts("blkcnt "); puts_dec(hwdrvblkdev_dev.blkcnt);
+	puts(" clkfreq "); puts_dec(hwdrvblkdev_clkfreq()); putchar('\n');
+	if (hwdrvblkdev_dev.blkcnt < (2*BLKBENCHBATCH) || hwdrvblkdev_dev.blkcnt < BLKBENCHOPCNT) {
+		puts("! blkdev too small\n");
+		return;
+	}
+	while (1) {
+		runtest ("seq read", HWDRVBLKDEV_READ, SEQ, 1);
+		runtest ("rand read", HWDRVBLKDEV_READ, RAND, 1);
+		runtest ("seq read batch", HWDRVBLKDEV_READ, SEQ, BLKBENCHBATCH);
+		#if BLKBENCHWRITE
+		runtest ("seq write", HWDRVBLKDEV_WRITE, SEQ, 1);
+		runtest ("rand write", HWDRVBLKDEV_WRITE, RAND, 1);
+		runtest ("seq write batch", HWDRVBLKDEV_WRITE, SEQ, BLKBENCHBATCH);
+		#endif
+		runnxt();
+		puts("status reads/cmd ");
+		puts_dec((hwdrvblkdev_dev.pollcnt[0] + hwdrvblkdev_dev.pollcnt[1]) /
+			((hwdrvblkdev_dev.opcnt[0] + hwdrvblkdev_dev.opcnt[1]) ?: 1));
+		puts(" memcpy KB "); puts_dec(hwdrvblkdev_dev.stats.memcpybytes / 1024);
+		puts(" errors "); puts_dec(errcnt);
+		puts("\ndone\n");
+	}
+}
@@ -0,0 +1,11 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// (c) William Fonkou Tambe
+
+#define STACKSZ		1024 /* estimate: about 500 bytes from host i386 -fstack-usage outputs, doubled for margin; re-check with pu32 ones */
+#define UARTADDR	(0x0ff8 /* By convention, the first UART is located at 0x0ff8 */)
+#define UARTBAUD	115200
+#define BLKDEVADDR	(0x0 /* By convention, the first block device is located at 0x0 */)
+#define BLKBENCHOPCNT	1024 /* operations per test */
+#define BLKBENCHBATCH	32 /* blocks per operation of the batch tests */
+#define BLKBENCHWRITE	0 /* non-null to run the write tests, which rewrite the boot disk */
+#define HWDRVBLKDEV_STATS
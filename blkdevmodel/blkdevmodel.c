@@ -0,0 +1,362 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// (c) William Fonkou Tambe
+
+// Host model of the block device controller used to run
+// hwdrvblkdev.h on the host and benchmark its use.
+// The model keeps a virtual clock which advances with every
+// ldst to the controller and every word copied through memcpy(),
+// so that results are reproducible and independent of the host.
+
+// Used for open().
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+// Used for pread(), pwrite(), ftruncate(), getopt().
+#include <unistd.h>
+// Other includes.
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The memcpy() used by the driver gets accounted in the virtual clock.
+void *hwdrvblkdev_host_memcpy (void *dst, const void *src, size_t cnt);
+#define memcpy hwdrvblkdev_host_memcpy
+#define HWDRVBLKDEV_HOST
+// The clock cycle counter used by the driver is the virtual clock.
+typedef union {
+	uint64_t val;
+} clkcyclecnt;
+clkcyclecnt getclkcyclecnt (void);
+
+#include <hwdrvblkdev/hwdrvblkdev.h>
+#undef memcpy
+
+// Model parameters; latencies are in clock cycles.
+unsigned long rdlat = 20000;	// Latency of READ.
+unsigned long wrlat = 40000;	// Latency of WRITE.
+unsigned long rstlat = 100000;	// Latency of RESET.
+unsigned long jitter = 0;	// Maximum random latency added to a command.
+unsigned long ldstcost = 20;	// Cost of an ldst to the controller.
+unsigned long cpycost = 2;	// Cost of copying a word with memcpy().
+unsigned long spincost = 4;	// Cost of reading the clock cycle counter.
+unsigned long clkfreq = 100000000;
+unsigned long errrate = 0;	// One command in errrate fails; 0 disables.
+
+// Model state.
+unsigned char window[BLKSZ];	// Buffer presented in the physical memory.
+unsigned char ctrlbuf[BLKSZ];	// Buffer used by the controller.
+unsigned long status = HWDRVBLKDEV_POWEROFF;
+unsigned long pendingcmd;
+unsigned long pendingidx;
+unsigned long pendingerr;
+unsigned long long busyuntil;
+unsigned long long clk;		// Virtual clock.
+unsigned long blkcnt = 8192;
+int imgfd;
+
+uint64_t rngstate = 1;
+
+// Pseudo-random number generator (xorshift64).
+uint64_t rng (void) {
+	rngstate ^= (rngstate << 13);
+	rngstate ^= (rngstate >> 7);
+	rngstate ^= (rngstate << 17);
+	return rngstate;
+}
+
+void *hwdrvblkdev_host_memcpy (void *dst, const void *src, size_t cnt) {
+	clk += (cpycost * (cnt / sizeof(unsigned long)));
+	return __builtin_memcpy (dst, src, cnt);
+}
+
+clkcyclecnt getclkcyclecnt (void) {
+	// Spinning on the clock cycle counter must advance the virtual clock.
+	clk += spincost;
+	return (clkcyclecnt){.val = clk};
+}
+
+unsigned long hwdrvblkdev_host_clkfreq (void) {
+	return clkfreq;
+}
+
+// Complete the command in progress.
+void complete (void) {
+	if (pendingerr) {
+		pendingerr = 0;
+		status = HWDRVBLKDEV_ERROR;
+		return;
+	}
+	if (pendingcmd == HWDRVBLKDEV_READ) {
+		if (pread (imgfd, ctrlbuf, BLKSZ, (off_t)pendingidx*BLKSZ) != BLKSZ) {
+			status = HWDRVBLKDEV_ERROR;
+			return;
+		}
+	} else if (pendingcmd == HWDRVBLKDEV_WRITE) {
+		if (pwrite (imgfd, ctrlbuf, BLKSZ, (off_t)pendingidx*BLKSZ) != BLKSZ) {
+			status = HWDRVBLKDEV_ERROR;
+			return;
+		}
+	}
+	status = HWDRVBLKDEV_READY;
+}
+
+unsigned long hwdrvblkdev_host_ldst (unsigned long v, void *addr) {
+	clk += ldstcost;
+	if (status == HWDRVBLKDEV_BUSY && clk >= busyuntil)
+		complete();
+	switch ((unsigned long)(addr - (void *)window)) {
+		case HWDRVBLKDEV_RESET:
+			if (v) {
+				pendingcmd = HWDRVBLKDEV_RESET;
+				pendingerr = 0;
+				busyuntil = (clk + rstlat);
+				status = HWDRVBLKDEV_BUSY;
+			}
+			return status;
+		case HWDRVBLKDEV_SWAP: {
+			// Swapping while the controller is busy is a driver bug
+			// which would otherwise go unnoticed as stale data.
+			if (status != HWDRVBLKDEV_READY) {
+				status = HWDRVBLKDEV_ERROR;
+				return 0;
+			}
+			unsigned char buf[BLKSZ];
+			__builtin_memcpy (buf, window, BLKSZ);
+			__builtin_memcpy (window, ctrlbuf, BLKSZ);
+			__builtin_memcpy (ctrlbuf, buf, BLKSZ);
+			return 0;
+		}
+		case HWDRVBLKDEV_READ:
+		case HWDRVBLKDEV_WRITE:
+			if (status != HWDRVBLKDEV_READY || v >= blkcnt) {
+				status = HWDRVBLKDEV_ERROR;
+				return blkcnt;
+			}
+			pendingcmd = (unsigned long)(addr - (void *)window);
+			pendingidx = v;
+			pendingerr = (errrate && !(rng() % errrate));
+			busyuntil = (clk +
+				((pendingcmd == HWDRVBLKDEV_READ) ? rdlat : wrlat) +
+				(jitter ? (rng() % (jitter + 1)) : 0));
+			status = HWDRVBLKDEV_BUSY;
+			return blkcnt;
+		default:
+			fprintf (stderr, "invalid controller address: %p\n", addr);
+			exit (1);
+	}
+}
+
+hwdrvblkdev dev = {.addr = (void *)window};
+
+unsigned long opcnt = 1024;	// Count of operations per test.
+unsigned long batchsz = 32;	// Count of blocks per pipelined request or copy.
+unsigned long errcnt;		// Count of device errors recovered.
+unsigned long long *lat;	// Latency of each operation.
+unsigned char *buf;
+
+// Test descriptions.
+enum {
+	SEQREAD, RANDREAD, SEQWRITE, RANDWRITE, SEQREADBATCH, SEQWRITEBATCH, SEQPEEKBATCH, COPY };
+
+// Run an operation, re-initializing the device and retrying on error.
+// Returns the status of the last attempt.
+signed long runop (unsigned long op, unsigned long idx, unsigned long cnt) {
+	unsigned long retry = 4;
+	while (1) {
+		signed long ret;
+		if (op == COPY) {
+			ret = ((hwdrvblkdev_cpy (&dev, (blkcnt/2)+idx, idx, cnt) == cnt) ?
+				HWDRVBLKDEV_RQSTDONE : HWDRVBLKDEV_RQSTERROR);
+		} else if (op == SEQPEEKBATCH) {
+			// Consume the blocks in the window, using only a byte of each.
+			unsigned long i = 0;
+			ret = HWDRVBLKDEV_RQSTDONE;
+			while (i < cnt) {
+				signed long isrdy;
+				while (!(isrdy = hwdrvblkdev_isrdy (&dev)));
+				if (isrdy < 0) {
+					ret = HWDRVBLKDEV_RQSTERROR;
+					break;
+				}
+				unsigned char *p = hwdrvblkdev_peek (&dev, idx+i, ((i+1) < cnt));
+				if (!p)
+					continue;
+				buf[0] ^= p[0];
+				hwdrvblkdev_release (&dev);
+				++i;
+			}
+		} else {
+			hwdrvblkdev_rqst rqst = {
+				.nxt = 0, .ptr = buf, .idx = idx, .cnt = cnt,
+				.op = ((op == SEQREAD || op == RANDREAD || op == SEQREADBATCH) ?
+					HWDRVBLKDEV_READ : HWDRVBLKDEV_WRITE)};
+			hwdrvblkdev_submit (&dev, &rqst);
+			ret = hwdrvblkdev_wait (&dev, &rqst);
+		}
+		if (ret == HWDRVBLKDEV_RQSTDONE || !retry--)
+			return ret;
+		++errcnt;
+		hwdrvblkdev_init (&dev, 0);
+	}
+}
+
+int cmplat (const void *a, const void *b) {
+	unsigned long long x = *(unsigned long long *)a, y = *(unsigned long long *)b;
+	return ((x > y) - (x < y));
+}
+
+// Print the results of a test.
+// The arguments cmdcnt, pollcnt and overshoot are the
+// hwdrvblkdev_isrdy() statistics accumulated by the test.
+void report (const char *name, unsigned long n, unsigned long blkperop, unsigned long long total,
+	unsigned long cmdcnt, unsigned long pollcnt, unsigned long long overshoot) {
+	qsort (lat, n, sizeof(*lat), cmplat);
+	double us = (1000000.0 / clkfreq);
+	double blkps = (total ? (((double)n * blkperop * clkfreq) / total) : 0);
+	printf ("%-14s %10.0f blk/s %8.2f MB/s  us/op p50 %9.1f p90 %9.1f p99 %9.1f max %9.1f"
+		"  polls/cmd %5.2f overshoot us/cmd %6.2f\n",
+		name, blkps, ((blkps * BLKSZ) / (1024*1024)),
+		(lat[(n*50)/100] * us), (lat[(n*90)/100] * us),
+		(lat[(n*99)/100] * us), (lat[n-1] * us),
+		(cmdcnt ? ((double)pollcnt / cmdcnt) : 0),
+		(cmdcnt ? ((overshoot * us) / cmdcnt) : 0));
+}
+
+void runtest (const char *name, unsigned long op) {
+	unsigned long cnt = ((op == SEQREADBATCH || op == SEQWRITEBATCH ||
+		op == SEQPEEKBATCH || op == COPY) ? batchsz : 1);
+	unsigned long n = opcnt;
+	unsigned long cmdcnt = (dev.opcnt[0] + dev.opcnt[1]);
+	unsigned long pollcnt = (dev.pollcnt[0] + dev.pollcnt[1]);
+	unsigned long long overshoot = (dev.overshoot[0] + dev.overshoot[1]);
+	unsigned long long start = clk;
+	for (unsigned long i = 0; i < n; ++i) {
+		unsigned long idx;
+		if (op == COPY)
+			idx = ((i*cnt) % ((blkcnt/2) - cnt));
+		else if (op == RANDREAD || op == RANDWRITE)
+			idx = (rng() % blkcnt);
+		else
+			idx = ((i*cnt) % (blkcnt - cnt));
+		unsigned long long t = clk;
+		if (runop (op, idx, cnt) != HWDRVBLKDEV_RQSTDONE) {
+			fprintf (stderr, "%s: device error at block %lu\n", name, idx);
+			exit (1);
+		}
+		lat[i] = (clk - t);
+	}
+	report (name, n, cnt, (clk - start),
+		((dev.opcnt[0] + dev.opcnt[1]) - cmdcnt),
+		((dev.pollcnt[0] + dev.pollcnt[1]) - pollcnt),
+		((dev.overshoot[0] + dev.overshoot[1]) - overshoot));
+}
+
+void usage (char *arg0) {
+	fprintf (stderr,
+		"usage: %s [options] <path/to/img>\n"
+		"	-b <n>	block count of the device (default %lu)\n"
+		"	-n <n>	operations per test (default %lu)\n"
+		"	-q <n>	blocks per pipelined request or copy (default %lu)\n"
+		"	-r <n>	READ latency in cycles (default %lu)\n"
+		"	-w <n>	WRITE latency in cycles (default %lu)\n"
+		"	-R <n>	RESET latency in cycles (default %lu)\n"
+		"	-j <n>	maximum random latency added to commands (default %lu)\n"
+		"	-l <n>	cycles per ldst to the controller (default %lu)\n"
+		"	-c <n>	cycles per word copied (default %lu)\n"
+		"	-p <n>	cycles per clock cycle counter read (default %lu)\n"
+		"	-F <n>	clock frequency in Hz (default %lu)\n"
+		"	-e <n>	fail one command in n (default 0: disabled)\n"
+		"	-s <n>	random seed (default %lu)\n",
+		arg0, blkcnt, opcnt, batchsz, rdlat, wrlat, rstlat, jitter,
+		ldstcost, cpycost, spincost, clkfreq, (unsigned long)rngstate);
+}
+
+int main (int argc, char **argv) {
+
+	int c;
+	while ((c = getopt (argc, argv, "b:n:q:r:w:R:j:l:c:p:F:e:s:")) != -1) {
+		unsigned long n = strtoul (optarg, 0, 0);
+		switch (c) {
+			case 'b': blkcnt = n; break;
+			case 'n': opcnt = n; break;
+			case 'q': batchsz = n; break;
+			case 'r': rdlat = n; break;
+			case 'w': wrlat = n; break;
+			case 'R': rstlat = n; break;
+			case 'j': jitter = n; break;
+			case 'l': ldstcost = n; break;
+			case 'c': cpycost = n; break;
+			case 'p': spincost = n; break;
+			case 'F': clkfreq = n; break;
+			case 'e': errrate = n; break;
+			case 's': rngstate = (n ? n : 1); break;
+			default: usage (argv[0]); return -1;
+		}
+	}
+
+	if (optind != (argc - 1) || !opcnt || !batchsz || !clkfreq || blkcnt < (4*batchsz)) {
+		usage (argv[0]);
+		return -1;
+	}
+
+	if ((imgfd = open (argv[optind], O_RDWR | O_CREAT, 0644)) == -1) {
+		fprintf (stderr, "could not open: %s\n", argv[optind]);
+		return -1;
+	}
+	struct stat st;
+	if (fstat (imgfd, &st) == -1 ||
+		(st.st_size < ((off_t)blkcnt*BLKSZ) && ftruncate (imgfd, (off_t)blkcnt*BLKSZ) == -1)) {
+		fprintf (stderr, "could not size: %s\n", argv[optind]);
+		return -1;
+	}
+
+	if (!(lat = malloc (opcnt * sizeof(*lat))) || !(buf = malloc (batchsz * BLKSZ))) {
+		fprintf (stderr, "malloc() failed\n");
+		return -1;
+	}
+	for (unsigned long i = 0; i < (batchsz * BLKSZ); ++i)
+		buf[i] = rng();
+
+	if (!hwdrvblkdev_init (&dev, 0)) {
+		fprintf (stderr, "blkdev initialization failed\n");
+		return -1;
+	}
+
+	printf ("blkcnt %lu; rdlat %lu; wrlat %lu; jitter %lu; ldst %lu; cpy %lu; spin %lu; clkfreq %lu; errrate %lu\n",
+		blkcnt, rdlat, wrlat, jitter, ldstcost, cpycost, spincost, clkfreq, errrate);
+
+	runtest ("seqwrite", SEQWRITE);
+	runtest ("seqread", SEQREAD);
+	runtest ("randwrite", RANDWRITE);
+	runtest ("randread", RANDREAD);
+	runtest ("seqwritebatch", SEQWRITEBATCH);
+	runtest ("seqreadbatch", SEQREADBATCH);
+	runtest ("seqpeekbatch", SEQPEEKBATCH);
+	runtest ("copy", COPY);
+
+	printf ("errors recovered %lu\n", errcnt);
+
+	#ifdef HWDRVBLKDEV_STATS
+	printf ("reads %lu; writes %lu; copied %lu; busy %lu; memcpy %llu bytes; resumes %lu\n",
+		dev.stats.rdcnt, dev.stats.wrcnt, dev.stats.cpycnt, dev.stats.bsycnt,
+		dev.stats.memcpybytes, dev.stats.resumecnt);
+	static const char *histname[] = {
+		[HWDRVBLKDEV_STATSINIT] = "init",
+		[HWDRVBLKDEV_STATSREAD] = "read",
+		[HWDRVBLKDEV_STATSWRITE] = "write",
+		[HWDRVBLKDEV_STATSCPY] = "cpy",
+	};
+	for (unsigned long i = 0; i < (sizeof(histname)/sizeof(histname[0])); ++i) {
+		printf ("%-5s cycles", histname[i]);
+		for (unsigned long j = 0; j < (sizeof(dev.stats.hist[0])/sizeof(dev.stats.hist[0][0])); ++j)
+			if (dev.stats.hist[i][j])
+				printf (" 2^%lu:%lu", j, dev.stats.hist[i][j]);
+		printf ("\n");
+	}
+	#endif
+
+	close (imgfd);
+
+	return 0;
+}
@@ -0,0 +1,137 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// (c) William Fonkou Tambe
+
+// Host tool bonding the ttys given as arguments, which must be listed
+// in the same order as the channels bonded by the other end; what is read from stdin gets striped across the ttys,
+// and the stream reassembled from the ttys gets written to stdout.
+
+// Used for open().
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+// Used for read(), write(), close().
+#include <unistd.h>
+// Used for poll().
+#include <poll.h>
+// Used for tty functions.
+#include <termios.h>
+// Used for ttyspeed().
+#include <baudneg/ttyspeed.h>
+// Other includes.
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <charbond/charbond.h>
+
+int ttyfds[CHARBOND_MAXCNT];
+
+static unsigned long readcb (void *arg, unsigned long ch, void *ptr, unsigned long sz) {
+	ssize_t n = read (ttyfds[ch], ptr, sz);
+	return ((n > 0) ? n : 0);
+}
+
+static unsigned long writecb (void *arg, unsigned long ch, void *ptr, unsigned long sz) {
+	unsigned long cnt = 0;
+	while (cnt < sz) {
+		ssize_t n = write (ttyfds[ch], ptr + cnt, sz - cnt);
+		if (n > 0)
+			cnt += n;
+		else if (n < 0 && errno != EAGAIN)
+			break;
+		else {
+			struct pollfd pollfd = {.fd = ttyfds[ch], .events = POLLOUT};
+			poll (&pollfd, 1, -1);
+		}
+	}
+	return cnt;
+}
+
+// Writes wait for the tty to drain, hence a channel is always writable.
+static unsigned long writablecb (void *arg, unsigned long ch) {
+	return (CHARBOND_HDRSZ + CHARBOND_FRAMESZ);
+}
+
+int main (int argc, char **argv) {
+
+	unsigned long baudrate = 115200;
+	int opt;
+	while ((opt = getopt (argc, argv, "b:")) != -1) {
+		if (opt == 'b')
+			baudrate = strtoul (optarg, 0, 0);
+		else
+			optind = argc;
+	}
+
+	unsigned long cnt = (argc - optind);
+	if (!cnt || cnt > CHARBOND_MAXCNT) {
+		fprintf (stderr, "usage: %s [-b baudrate] <path/to/tty> [path/to/tty ...]\n", argv[0]);
+		return -1;
+	}
+
+	speed_t speed = ttyspeed (baudrate);
+	if (speed == B0) {
+		fprintf (stderr, "unsupported baudrate: %lu\n", baudrate);
+		return -1;
+	}
+
+	unsigned long i;
+	for (i = 0; i < cnt; ++i) {
+		char *path = argv[optind+i];
+		struct termios ttyconfig;
+		if ((ttyfds[i] = open (path, O_RDWR | O_NOCTTY | O_NONBLOCK)) == -1) {
+			fprintf (stderr, "could not open: %s\n", path);
+			return -1;
+		}
+		if (!isatty (ttyfds[i]) || tcgetattr (ttyfds[i], &ttyconfig)) {
+			fprintf (stderr, "not a tty: %s\n", path);
+			return -1;
+		}
+		cfmakeraw (&ttyconfig);
+		if (cfsetispeed (&ttyconfig, speed) || cfsetospeed (&ttyconfig, speed) ||
+			tcsetattr (ttyfds[i], TCSANOW, &ttyconfig)) {
+			fprintf (stderr, "applying tty config failed: %s\n", path);
+			return -1;
+		}
+		tcflush (ttyfds[i], TCIOFLUSH);
+	}
+
+	charbond b = {
+		.cnt = cnt,
+		.read = readcb,
+		.write = writecb,
+		.writable = writablecb};
+
+	unsigned char buf[4096];
+	unsigned long errcnt = 0;
+	int stdineof = 0;
+
+	while (1) {
+		// Only the ttys not holding a whole frame are polled,
+		// since charbond_read() does not read them further.
+		struct pollfd pollfds[1+CHARBOND_MAXCNT] = {
+			{.fd = (stdineof ? -1 : 0), .events = POLLIN}};
+		for (i = 0; i < cnt; ++i)
+			pollfds[1+i] = (struct pollfd){
+				.fd = (charbond_rxwhole (&b, i) ? -1 : ttyfds[i]), .events = POLLIN};
+		if (poll (pollfds, 1+cnt, -1) <= 0)
+			continue;
+		ssize_t n;
+		if (pollfds[0].revents & (POLLIN|POLLHUP)) {
+			if ((n = read (0, buf, sizeof(buf))) > 0)
+				charbond_write (&b, buf, n);
+			else
+				stdineof = 1;
+		}
+		for (i = 0; i < cnt && !(pollfds[1+i].revents & POLLIN); ++i);
+		if (i < cnt) {
+			while ((n = charbond_read (&b, buf, sizeof(buf))) > 0)
+				write (1, buf, n);
+			if (b.errcnt != errcnt) {
+				errcnt = b.errcnt;
+				fprintf (stderr, "charbond: synchronization lost %lu times\n", errcnt);
+			}
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,163 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// (c) William Fonkou Tambe
+
+#ifndef CHARBOND_H
+#define CHARBOND_H
+
+// Bonding of byte channels, such as UARTs, into a single stream.
+// The stream is split into frames formatted as follow:
+// |seq: 1byte|len: 1byte|payload: len bytes|
+// where seq increments with each frame, and len is never null.
+// Frames are sent round-robin across the channels; the receiver holds
+// a frame per channel, and reassembles the stream delivering the frames
+// in seq order, whatever the order in which the channels deliver them.
+// A frame missing gets skipped once every channel holds a frame, or once
+// a frame at least the count of channels ahead arrived, since its channel
+// has then carried the next frames; frames behind get dropped.
+// It only depends on the callbacks below, so that a target driver can
+// share it with host tools.
+
+#define CHARBOND_MAXCNT		8 /* max count of channels bonded */
+#define CHARBOND_HDRSZ		2
+#define CHARBOND_FRAMESZ	64 /* max payload byte size; must be less than 256 */
+
+typedef struct {
+	// Count of channels bonded.
+	unsigned long cnt;
+	// Value passed to the callbacks below; they must not block,
+	// returning the byte amount transferred with the channel
+	// indexed by their argument ch.
+	void *arg;
+	unsigned long (*read) (void *arg, unsigned long ch, void *ptr, unsigned long sz);
+	unsigned long (*write) (void *arg, unsigned long ch, void *ptr, unsigned long sz);
+	// Return the byte amount that can be written to the channel without blocking.
+	unsigned long (*writable) (void *arg, unsigned long ch);
+	// Sequence number and channel of the next frame to send.
+	unsigned char txseq;
+	unsigned long txch;
+	// Sequence number of the next frame to deliver.
+	unsigned char rxseq;
+	// Frame being received on each channel: its header bytes received,
+	// its payload bytes received, and its payload bytes delivered;
+	// a channel holding a whole frame is not read further.
+	struct {
+		unsigned long hdrlen, len, off;
+		unsigned char hdr[CHARBOND_HDRSZ];
+		unsigned char buf[CHARBOND_FRAMESZ];
+	} rx[CHARBOND_MAXCNT];
+	// Count of invalid, missing or dropped frames.
+	unsigned long errcnt;
+} charbond;
+
+// Write the byte amount given by the argument sz from the buffer given by
+// the argument ptr, splitting it into frames, each sent only once the channel
+// to carry it can accept it whole.
+// Return the byte amount written.
+static unsigned long charbond_write (charbond *b, void *ptr, unsigned long sz) {
+	unsigned char *p = ptr;
+	unsigned long cnt = 0;
+	while (sz) {
+		unsigned long n = b->writable (b->arg, b->txch);
+		if (n <= CHARBOND_HDRSZ)
+			break;
+		n -= CHARBOND_HDRSZ;
+		if (n > CHARBOND_FRAMESZ)
+			n = CHARBOND_FRAMESZ;
+		if (n > sz)
+			n = sz;
+		unsigned char hdr[CHARBOND_HDRSZ] = {b->txseq, n};
+		b->write (b->arg, b->txch, hdr, CHARBOND_HDRSZ);
+		b->write (b->arg, b->txch, p, n);
+		++b->txseq;
+		if (++b->txch == b->cnt)
+			b->txch = 0;
+		p += n;
+		sz -= n;
+		cnt += n;
+	}
+	return cnt;
+}
+
+// Return non-null if the channel given by the argument ch holds a whole frame.
+static inline unsigned long charbond_rxwhole (charbond *b, unsigned long ch) {
+	return (b->rx[ch].hdrlen == CHARBOND_HDRSZ && b->rx[ch].len == b->rx[ch].hdr[1]);
+}
+
+// Receive from each channel not holding a whole frame, the frame it carries.
+static void charbond_rxfill (charbond *b) {
+	for (unsigned long ch = 0; ch < b->cnt; ++ch) {
+		typeof(b->rx[0]) *r = &b->rx[ch];
+		while (!charbond_rxwhole (b, ch)) {
+			unsigned long n;
+			if (r->hdrlen < CHARBOND_HDRSZ) {
+				if (!(n = b->read (b->arg, ch, &r->hdr[r->hdrlen], (CHARBOND_HDRSZ - r->hdrlen))))
+					break;
+				if ((r->hdrlen += n) == CHARBOND_HDRSZ &&
+					(!r->hdr[1] || r->hdr[1] > CHARBOND_FRAMESZ)) {
+					// Invalid frame: look for the next header on the same channel.
+					++b->errcnt;
+					r->hdrlen = 0;
+				}
+				continue;
+			}
+			if (!(n = b->read (b->arg, ch, &r->buf[r->len], (r->hdr[1] - r->len))))
+				break;
+			r->len += n;
+		}
+	}
+}
+
+// Read up to the byte amount given by the argument sz into the buffer
+// given by the argument ptr, reassembling the stream from the frames.
+// Return the byte amount read.
+static unsigned long charbond_read (charbond *b, void *ptr, unsigned long sz) {
+	unsigned char *p = ptr;
+	unsigned long cnt = 0;
+	while (sz) {
+		charbond_rxfill (b);
+		// Find the channel holding the frame closest to rxseq, dropping
+		// the frames behind it, ie: half the seq space or more ahead.
+		unsigned long ch, next = -1, held = 0, mindist = -1, maxdist = 0;
+		for (ch = 0; ch < b->cnt; ++ch) {
+			if (!charbond_rxwhole (b, ch))
+				continue;
+			unsigned long dist = (unsigned char)(b->rx[ch].hdr[0] - b->rxseq);
+			if (dist >= 128) {
+				++b->errcnt;
+				b->rx[ch].hdrlen = b->rx[ch].len = b->rx[ch].off = 0;
+				continue;
+			}
+			++held;
+			if (dist < mindist) {
+				mindist = dist;
+				next = ch;
+			}
+			if (dist > maxdist)
+				maxdist = dist;
+		}
+		if (next == (unsigned long)-1)
+			break;
+		if (mindist) {
+			if (held < b->cnt && maxdist < b->cnt)
+				break; // The frame to deliver next may still arrive.
+			++b->errcnt;
+			b->rxseq = b->rx[next].hdr[0];
+		}
+		typeof(b->rx[0]) *r = &b->rx[next];
+		unsigned long n = (r->len - r->off);
+		if (n > sz)
+			n = sz;
+		for (unsigned long i = 0; i < n; ++i)
+			p[i] = r->buf[r->off + i];
+		p += n;
+		sz -= n;
+		cnt += n;
+		if ((r->off += n) == r->len) {
+			r->hdrlen = r->len = r->off = 0;
+			++b->rxseq;
+		}
+	}
+	return cnt;
+}
+
+#endif /* CHARBOND_H */
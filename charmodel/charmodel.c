@@ -0,0 +1,183 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// (c) William Fonkou Tambe
+
+// Host model of the UART receive path used to benchmark the moderation
+// of the receive interrupt from hwdrvchar.h against fixed thresholds.
+// Bytes arrive at the line rate following a traffic pattern; software
+// receives them either after an interrupt, or when polling the UART every
+// budget, as the BIOS does in uart_service(); the model keeps a virtual
+// clock so that results are reproducible and independent of the host.
+
+// Used for getopt().
+#include <unistd.h>
+// Other includes.
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <hwdrvchar/hwdrvchar.h>
+
+// Model parameters; latencies are in clock cycles.
+unsigned long clkfreq = 100000000;
+unsigned long bufsz = 64;	// Size of the receive buffer.
+unsigned long intrlat = 2000;	// Latency from an interrupt to software receiving.
+unsigned long budget = 0;	// Polling period; 0 means (clkfreq/1000).
+unsigned long long nbytes = 65536; // Bytes per bulk test.
+
+uint64_t rngstate = 1;
+
+// Pseudo-random number generator (xorshift64).
+uint64_t rng (void) {
+	rngstate ^= (rngstate << 13);
+	rngstate ^= (rngstate >> 7);
+	rngstate ^= (rngstate << 17);
+	return rngstate;
+}
+
+// Traffic patterns; arrival() returns the arrival time of the byte
+// given by the argument i, where the argument bytetime is the line
+// time of a byte; bytes must arrive in order.
+enum {INTERACTIVE, BURSTY, BULK, PATTERNCNT};
+char *patternname[PATTERNCNT] = {"interactive", "bursty", "bulk"};
+unsigned long long patternbytes (unsigned long p) {
+	return ((p == INTERACTIVE) ? 256 : (p == BURSTY) ? (64*512) : nbytes);
+}
+unsigned long long arrival (unsigned long p, unsigned long long i, unsigned long long bytetime) {
+	static unsigned long long t;
+	if (!i)
+		t = 0;
+	if (p == INTERACTIVE) // A keystroke every 50ms to 150ms.
+		t += ((clkfreq/20) + (rng() % (clkfreq/10)));
+	else if (p == BURSTY && !(i % 512)) // 512 bytes at line rate every 100ms.
+		t += (clkfreq/10);
+	else
+		t += bytetime;
+	return t;
+}
+
+// Results of a test.
+typedef struct {
+	unsigned long long bytes, intrcnt, pollcnt, dropcnt;
+	unsigned long long lattotal, latmax;
+} result;
+
+// Run the pattern given by the argument p at the baudrate given by the argument
+// baud, using the fixed threshold given by the argument thr, or adaptive
+// moderation when it is null.
+result run (unsigned long p, unsigned long baud, unsigned long thr) {
+	result r = {0};
+	hwdrvchar_rxmod m;
+	hwdrvchar_rxmod_init (&m, budget, (bufsz/2));
+	unsigned long threshold = (thr ? thr : m.threshold);
+	unsigned long long bytetime = ((10ULL * clkfreq) / baud); // 8N1.
+	unsigned long long *buf = malloc (bufsz * sizeof(unsigned long long));
+	unsigned long head = 0, tail = 0;
+	unsigned long long nextpoll = budget, intrat = -1, n = patternbytes (p);
+	unsigned long intrena = 1;
+	// Receive the bytes in the buffer at the time given by the argument t.
+	void service (unsigned long long t, unsigned long isintr) {
+		if (isintr) {
+			intrat = -1;
+			++r.intrcnt;
+		} else
+			++r.pollcnt;
+		unsigned long cnt = (head - tail);
+		while (tail != head) {
+			unsigned long long lat = (t - buf[(tail++)%bufsz]);
+			r.lattotal += lat;
+			if (r.latmax < lat)
+				r.latmax = lat;
+		}
+		unsigned long t2 = hwdrvchar_rxmod_update (&m, cnt, t);
+		if (!thr)
+			threshold = t2;
+		intrena = 1;
+		nextpoll = (t + budget);
+	}
+	for (unsigned long long i = 0; i <= n; ++i) {
+		// The last iteration flushes the bytes left in the buffer.
+		unsigned long long a = ((i < n) ? arrival (p, i, bytetime) : -1);
+		while (1) {
+			unsigned long long t = ((intrat < nextpoll) ? intrat : nextpoll);
+			if (t > a || (a == -1 && tail == head))
+				break;
+			service (t, (t == intrat));
+		}
+		if (i == n)
+			break;
+		if ((head - tail) == bufsz) {
+			++r.dropcnt;
+			continue;
+		}
+		buf[(head++)%bufsz] = a;
+		++r.bytes;
+		// The interrupt handler disables the interrupt until the bytes get received.
+		if (intrena && (head - tail) >= threshold) {
+			intrena = 0;
+			intrat = (a + intrlat);
+		}
+	}
+	free (buf);
+	return r;
+}
+
+void usage (char *arg0) {
+	fprintf (stderr,
+		"usage: %s [options]\n"
+		"	-b <n>	receive buffer size (default %lu)\n"
+		"	-l <n>	cycles from interrupt to software receiving (default %lu)\n"
+		"	-u <n>	polling period in cycles (default clkfreq/1000)\n"
+		"	-n <n>	bytes per bulk test (default %llu)\n"
+		"	-F <n>	clock frequency in Hz (default %lu)\n"
+		"	-s <n>	random seed (default %lu)\n",
+		arg0, bufsz, intrlat, nbytes, clkfreq, (unsigned long)rngstate);
+}
+
+int main (int argc, char **argv) {
+
+	int c;
+	while ((c = getopt (argc, argv, "b:l:u:n:F:s:")) != -1) {
+		unsigned long n = strtoul (optarg, 0, 0);
+		switch (c) {
+			case 'b': bufsz = n; break;
+			case 'l': intrlat = n; break;
+			case 'u': budget = n; break;
+			case 'n': nbytes = n; break;
+			case 'F': clkfreq = n; break;
+			case 's': rngstate = (n ? n : 1); break;
+			default: usage (argv[0]); return -1;
+		}
+	}
+
+	if (optind != argc || bufsz < 2 || !nbytes || !clkfreq) {
+		usage (argv[0]);
+		return -1;
+	}
+
+	if (!budget)
+		budget = (clkfreq/1000);
+
+	printf ("bufsz %lu; intrlat %lu; budget %lu; clkfreq %lu\n", bufsz, intrlat, budget, clkfreq);
+
+	static unsigned long bauds[] = {9600, 115200, 921600, 3000000};
+	unsigned long thrs[] = {1, 8, (bufsz/2), 0};
+	for (unsigned long b = 0; b < (sizeof(bauds)/sizeof(bauds[0])); ++b) {
+		for (unsigned long p = 0; p < PATTERNCNT; ++p) {
+			for (unsigned long t = 0; t < (sizeof(thrs)/sizeof(thrs[0])); ++t) {
+				result r = run (p, bauds[b], thrs[t]);
+				char thrname[16];
+				if (thrs[t])
+					snprintf (thrname, sizeof(thrname), "fixed %lu", thrs[t]);
+				else
+					snprintf (thrname, sizeof(thrname), "adaptive");
+				printf ("%8lu bps %-12s %-9s intr/KB %8.2f  latency us avg %9.1f max %9.1f  drops %llu\n",
+					bauds[b], patternname[p], thrname,
+					((r.intrcnt * 1024.0) / (r.bytes ? r.bytes : 1)),
+					(((r.lattotal * 1000000.0) / clkfreq) / (r.bytes ? r.bytes : 1)),
+					((r.latmax * 1000000.0) / clkfreq), r.dropcnt);
+			}
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,45 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// (c) William Fonkou Tambe
+
+#ifndef CONS_H
+#define CONS_H
+
+// Buffered console over an UART: bytes accumulate in a line buffer
+// which gets written to the device in a single hwdrvchar_write()
+// on newline, when the buffer is full, or through cons_flush().
+
+#include <hwdrvchar/hwdrvchar.h>
+
+#ifndef CONSBUFSZ
+#define CONSBUFSZ 128
+#endif
+
+typedef struct {
+	hwdrvchar *dev; // UART device written to.
+	unsigned long len; // Count of bytes in buf.
+	unsigned char buf[CONSBUFSZ];
+} cons;
+
+// Write to the UART device the bytes buffered,
+// returning only once all of them have been written.
+static void cons_flush (cons *c) {
+	unsigned char *p = c->buf;
+	unsigned long n = c->len;
+	while (n) {
+		unsigned long w = hwdrvchar_write (c->dev, p, n);
+		if (!w && hwdrvchar_isbsy)
+			hwdrvchar_isbsy();
+		p += w;
+		n -= w;
+	}
+	c->len = 0;
+}
+
+// Buffer the byte given by the argument ch.
+static inline void cons_putc (cons *c, unsigned char ch) {
+	c->buf[c->len++] = ch;
+	if (ch == '\n' || c->len == CONSBUFSZ)
+		cons_flush (c);
+}
+
+#endif /* CONS_H */
@@ -0,0 +1,427 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// (c) William Fonkou Tambe
+
+// Console to the UART used by the BIOS, which negotiates with
+// the BIOS, as described in baudneg.h, the fastest baudrate
+// that the tty and the SoC clock can both generate, and which
+// can send the BIOS the kernel to boot, as described in uartboot.h .
+
+// Used for open().
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+// Used for read(), write(), close().
+#include <unistd.h>
+// Used for poll().
+#include <poll.h>
+// Used for tty functions.
+#include <termios.h>
+// Used for ttyspeed().
+#include <baudneg/ttyspeed.h>
+// Used for the negotiation protocol.
+#include <baudneg/baudneg.h>
+// Other includes.
+#include <stdint.h>
+#include <uartboot/uartboot.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Baudrates tried in increasing order.
+static unsigned long baudrates[] = {
+	230400, 460800, 921600, 1000000, 1500000, 2000000, 3000000, 4000000 };
+
+// Key used to quit the console: ctrl+].
+#define QUITKEY 0x1d
+
+// Max count of UARTBOOT_END sent without acknowledgement; since the BIOS
+// jumps to the kernel after acknowledging it, an acknowledgement lost
+// would otherwise get UARTBOOT_END resent forever.
+#define ENDRETRIES 8
+
+int ttyfd;
+
+struct termios origterm;
+
+void quit (int status) {
+	close(ttyfd);
+	tcsetattr (0, TCSANOW, &origterm);
+	exit (status);
+}
+
+static uint64_t nowms (void) {
+	struct timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ((ts.tv_sec*1000) + (ts.tv_nsec/1000000));
+}
+
+static void sleepms (unsigned long ms) {
+	struct timespec ts = {.tv_sec = (ms/1000), .tv_nsec = ((ms%1000)*1000000)};
+	nanosleep (&ts, 0);
+}
+
+// Switch the tty to the baudrate given as argument,
+// after the bytes written to it have been sent.
+static int setbaudrate (unsigned long baudrate) {
+	struct termios ttyconfig;
+	speed_t speed = ttyspeed (baudrate);
+	tcdrain (ttyfd);
+	if (speed == B0 || tcgetattr (ttyfd, &ttyconfig) ||
+		cfsetispeed (&ttyconfig, speed) || cfsetospeed (&ttyconfig, speed) ||
+		tcsetattr (ttyfd, TCSANOW, &ttyconfig))
+		return -1;
+	return 0;
+}
+
+// Read into the buffer given by the argument ptr, the byte amount given
+// by the argument sz, within the milliseconds given by the argument ms.
+// Return the byte amount read.
+static size_t readtimeout (void *ptr, size_t sz, unsigned long ms) {
+	uint64_t end = (nowms() + ms);
+	size_t cnt = 0;
+	while (cnt < sz) {
+		uint64_t now = nowms();
+		if (now >= end)
+			break;
+		struct pollfd pollfd = {.fd = ttyfd, .events = POLLIN};
+		if (poll (&pollfd, 1, (end - now)) <= 0)
+			break;
+		ssize_t n = read (ttyfd, ptr + cnt, sz - cnt);
+		if (n <= 0)
+			break;
+		cnt += n;
+	}
+	return cnt;
+}
+
+// Try the baudrate given as argument.
+// Return 1 if it should be kept, 0 if the BIOS declined it,
+// or -1 if it failed, in which case the BIOS reverts to its
+// previous baudrate.
+static int trybaudrate (unsigned long baudrate) {
+	unsigned char buf[BAUDNEG_PATTERNSZ];
+	unsigned long i;
+	if (ttyspeed (baudrate) == B0)
+		return 0;
+	buf[0] = BAUDNEG_CMDRATE;
+	for (i = 0; i < 4; ++i)
+		buf[1+i] = (baudrate >> (i*8));
+	write (ttyfd, buf, 5);
+	if (!readtimeout (buf, 1, BAUDNEG_TIMEOUT))
+		return -1;
+	if (buf[0] != BAUDNEG_YES)
+		return 0;
+	// Give the BIOS time to switch, and discard
+	// what was received meanwhile.
+	if (setbaudrate (baudrate))
+		return -1;
+	sleepms (5);
+	tcflush (ttyfd, TCIFLUSH);
+	for (i = 0; i < BAUDNEG_PATTERNSZ; ++i)
+		buf[i] = baudneg_pattern(i);
+	write (ttyfd, buf, BAUDNEG_PATTERNSZ);
+	if (readtimeout (buf, BAUDNEG_PATTERNSZ, BAUDNEG_TIMEOUT) != BAUDNEG_PATTERNSZ)
+		return -1;
+	for (i = 0; i < BAUDNEG_PATTERNSZ; ++i)
+		if (buf[i] != baudneg_pattern(i))
+			return -1;
+	buf[0] = BAUDNEG_CMDKEEP;
+	write (ttyfd, buf, 1);
+	if (!readtimeout (buf, 1, BAUDNEG_TIMEOUT) || buf[0] != BAUDNEG_ACK)
+		return -1;
+	return 1;
+}
+
+// Negotiate the baudrate once the BIOS acknowledged the request,
+// trying the baudrates up to the one given as argument.
+// Return the baudrate agreed.
+static unsigned long baudneg (unsigned long maxbaudrate) {
+	unsigned long baudrate = 115200, i;
+	for (i = 0; i < (sizeof(baudrates)/sizeof(baudrates[0])) && baudrates[i] <= maxbaudrate; ++i) {
+		int ret = trybaudrate (baudrates[i]);
+		if (ret > 0)
+			baudrate = baudrates[i];
+		else if (ret < 0) {
+			// Wait for the BIOS to revert.
+			sleepms (2*BAUDNEG_TIMEOUT);
+			setbaudrate (baudrate);
+			tcflush (ttyfd, TCIFLUSH);
+			break;
+		}
+	}
+	unsigned char c = BAUDNEG_CMDDONE;
+	write (ttyfd, &c, 1);
+	fprintf (stderr, "baudrate: %lu\r\n", baudrate);
+	return baudrate;
+}
+
+static void sendframe (unsigned char type, unsigned long seq, void *ptr, unsigned long len) {
+	unsigned char buf[UARTBOOT_HDRSZ+UARTBOOT_FRAMESZ+4];
+	buf[0] = type;
+	buf[1] = seq; buf[2] = (seq >> 8);
+	buf[3] = len; buf[4] = (len >> 8);
+	memcpy (&buf[UARTBOOT_HDRSZ], ptr, len);
+	uint32_t crc = uartboot_crc32 (0, buf, (UARTBOOT_HDRSZ+len));
+	unsigned long i;
+	for (i = 0; i < 4; ++i)
+		buf[UARTBOOT_HDRSZ+len+i] = (crc >> (i*8));
+	write (ttyfd, buf, (UARTBOOT_HDRSZ+len+4));
+}
+
+// Wait up to the milliseconds given by the argument ms for a reply
+// from the BIOS, returning its type and seq in the arguments *type and *seq.
+// Return 0 if no reply was received.
+static int readreply (unsigned long ms, unsigned char *type, unsigned long *seq) {
+	static unsigned char r[5];
+	static unsigned long n = 0;
+	do {
+		while (n < sizeof(r) && readtimeout (&r[n], 1, ms))
+			++n;
+		if (n < sizeof(r))
+			return 0;
+		if (((r[0]^UARTBOOT_ACKMASK) >= UARTBOOT_HDR && (r[0]^UARTBOOT_ACKMASK) <= UARTBOOT_END) ||
+			r[0] == UARTBOOT_NAK) {
+			if ((r[1]^r[3]) == 0xff && (r[2]^r[4]) == 0xff) {
+				*type = r[0];
+				*seq = (r[1] | (r[2] << 8));
+				n = 0;
+				return 1;
+			}
+		}
+		// Resynchronize on the next byte.
+		memmove (r, &r[1], --n);
+	} while (1);
+}
+
+// Send the BIOS the kernel image from the file given by the argument path,
+// as described in uartboot.h, then report the effective throughput.
+// Return 0 on success.
+static int uartbootsend (char *path, unsigned long baudrate) {
+	FILE *f = fopen (path, "rb");
+	if (!f) {
+		fprintf (stderr, "could not open: %s\r\n", path);
+		return -1;
+	}
+	fseek (f, 0, SEEK_END);
+	unsigned long sz = ftell (f);
+	rewind (f);
+	unsigned char *img = malloc (sz);
+	if (!img || fread (img, 1, sz, f) != sz) {
+		fprintf (stderr, "could not read: %s\r\n", path);
+		fclose (f);
+		return -1;
+	}
+	fclose (f);
+	unsigned long nframes = ((sz + (UARTBOOT_FRAMESZ-1)) / UARTBOOT_FRAMESZ);
+	if (!sz || nframes > 0x10000) {
+		fprintf (stderr, "invalid kernel size: %lu\r\n", sz);
+		return -1;
+	}
+	unsigned char *acked = calloc (nframes, 1);
+	uint64_t *sentms = calloc (nframes, sizeof(uint64_t));
+	// Order in which frames were last sent; since the line
+	// delivers frames in order, a frame sent before one being
+	// acknowledged, but not itself acknowledged, got lost
+	// and is retransmitted without waiting for its timeout.
+	unsigned long *sentord = calloc (nframes, sizeof(unsigned long)), sentcnt = 0;
+	// Time after which an unacknowledged frame gets retransmitted:
+	// twice the time to send a window, with margin.
+	unsigned long rto = (20 + ((2*(UARTBOOT_WINDOW+1)*(UARTBOOT_HDRSZ+UARTBOOT_FRAMESZ+4)*10*1000)/baudrate));
+	unsigned long retransmits = 0, base = 0, next = 0, seq, i;
+	unsigned char type, hdr[8];
+	uint32_t crc = uartboot_crc32 (0, img, sz);
+	for (i = 0; i < 4; ++i) {
+		hdr[i] = (sz >> (i*8));
+		hdr[4+i] = (crc >> (i*8));
+	}
+	// Wait for the BIOS to have discarded the UARTBOOT_KEY sent.
+	sleepms (UARTBOOT_TIMEOUT);
+	tcflush (ttyfd, TCIFLUSH);
+	uint64_t start = nowms();
+	do {
+		type = 0;
+		sendframe (UARTBOOT_HDR, 0, hdr, sizeof(hdr));
+		if (readreply (rto, &type, &seq) && type == UARTBOOT_NAK) {
+			fprintf (stderr, "kernel rejected: %lu bytes\r\n", sz);
+			return -1;
+		}
+	} while (type != (UARTBOOT_HDR^UARTBOOT_ACKMASK));
+	while (base < nframes) {
+		// Retransmit the oldest timed out frame, otherwise
+		// send the next frame if the window allows it.
+		uint64_t now = nowms();
+		for (i = base; i < next; ++i) {
+			if (!acked[i] && (now - sentms[i]) >= rto) {
+				++retransmits;
+				break;
+			}
+		}
+		if (i == next && (next == nframes || next >= (base + UARTBOOT_WINDOW)))
+			i = nframes;
+		if (i < nframes) {
+			unsigned long len = ((i == (nframes-1)) ? (sz - (i*UARTBOOT_FRAMESZ)) : UARTBOOT_FRAMESZ);
+			sendframe (UARTBOOT_DATA, i, &img[i*UARTBOOT_FRAMESZ], len);
+			sentms[i] = nowms();
+			sentord[i] = ++sentcnt;
+			if (i == next)
+				++next;
+		}
+		// Collect the acknowledgements received, waiting
+		// for one only if no frame could be sent.
+		while (readreply ((i < nframes) ? 0 : 1, &type, &seq)) {
+			if (type == (UARTBOOT_DATA^UARTBOOT_ACKMASK) && seq < nframes && !acked[seq]) {
+				acked[seq] = 1;
+				unsigned long j;
+				for (j = base; j < next; ++j)
+					if (!acked[j] && sentord[j] < sentord[seq])
+						sentms[j] = 0;
+			}
+		}
+		while (base < nframes && acked[base])
+			++base;
+	}
+	i = 0;
+	do {
+		if (i++ == ENDRETRIES) {
+			fprintf (stderr, "end of transfer not acknowledged; the kernel may have booted\r\n");
+			return -1;
+		}
+		type = 0;
+		sendframe (UARTBOOT_END, 0, 0, 0);
+		if (readreply (rto, &type, &seq) && type == UARTBOOT_NAK) {
+			fprintf (stderr, "kernel corrupted during transfer\r\n");
+			return -1;
+		}
+	} while (type != (UARTBOOT_END^UARTBOOT_ACKMASK));
+	double secs = ((nowms() - start) / 1000.0);
+	fprintf (stderr, "sent %lu bytes in %.3fs: %.0f bytes/s, %.0f%% of the line rate, %lu retransmits\r\n",
+		sz, secs, (sz / secs), ((100.0 * sz * 10) / (secs * baudrate)), retransmits);
+	free (sentord);
+	free (sentms);
+	free (acked);
+	free (img);
+	return 0;
+}
+
+int main (int argc, char **argv) {
+
+	unsigned long maxbaudrate = -1;
+	char *kernel = 0;
+	int opt;
+	while ((opt = getopt (argc, argv, "b:k:")) != -1) {
+		if (opt == 'b')
+			maxbaudrate = strtoul (optarg, 0, 0);
+		else if (opt == 'k')
+			kernel = optarg;
+		else
+			optind = argc;
+	}
+
+	if (optind != (argc - 1)) {
+		fprintf (stderr, "usage: %s [-b maxbaudrate] [-k path/to/kernel] <path/to/tty>\n", argv[0]);
+		return -1;
+	}
+
+	if ((ttyfd = open (argv[optind], O_RDWR | O_NOCTTY)) == -1) {
+		fprintf (stderr, "could not open: %s\n", argv[optind]);
+		return -1;
+	}
+
+	struct termios ttyconfig;
+
+	tcgetattr (0, &origterm);
+
+	if (isatty(ttyfd)) {
+		// Discard any data currently
+		// buffered in the tty.
+		tcflush(ttyfd, TCIOFLUSH);
+		// Retrieve the current tty config.
+		if (tcgetattr(ttyfd, &ttyconfig) == 0) {
+			// Set the tty to raw mode.
+			cfmakeraw(&ttyconfig);
+			// A read() returns what is available without blocking.
+			ttyconfig.c_cc[VMIN] = 0;
+			ttyconfig.c_cc[VTIME] = 0;
+			// Apply the new tty config.
+			if (tcsetattr(ttyfd, TCSANOW, &ttyconfig) == 0 &&
+				setbaudrate (115200) == 0)
+				goto ttyready;
+			else fprintf(stderr, "applying tty config failed\n");
+		} else fprintf(stderr, "retrieving tty config failed\n");
+	} else fprintf(stderr, "not a tty: %s\n", argv[optind]);
+
+	quit(1);
+
+	ttyready:;
+
+	struct termios term = origterm;
+	term.c_lflag &= ~(ICANON|ECHO|ISIG);
+	tcsetattr (0, TCSANOW, &term);
+
+	struct pollfd pollfds[2] = {
+		{.fd = 0, .events = POLLIN},
+		{.fd = ttyfd, .events = POLLIN}};
+
+	unsigned char buf[256];
+	ssize_t n;
+
+	unsigned long baudrate = 115200;
+	int negotiate = 1;
+
+	// Send the negotiation request until the BIOS acknowledges it
+	// or a key is pressed; when a kernel is to be sent, request
+	// UART boot mode until the BIOS enters it.
+	fprintf (stderr, "waiting for the BIOS; press a key to skip negotiation\r\n");
+	while (1) {
+		if (negotiate)
+			write (ttyfd, BAUDNEG_RQST, sizeof(BAUDNEG_RQST)-1);
+		if (kernel) {
+			buf[0] = UARTBOOT_KEY;
+			write (ttyfd, buf, 1);
+		}
+		if (poll (pollfds, 2, 10) <= 0)
+			continue;
+		if (pollfds[0].revents & POLLIN) {
+			read (0, buf, sizeof(buf));
+			if (!kernel)
+				goto console;
+			negotiate = 0;
+		}
+		if ((pollfds[1].revents & POLLIN) && (n = read (ttyfd, buf, 1)) > 0) {
+			if (negotiate && buf[0] == BAUDNEG_ACK) {
+				baudrate = baudneg (maxbaudrate);
+				negotiate = 0;
+				if (!kernel)
+					break;
+			} else if (kernel && buf[0] == UARTBOOT_READY) {
+				if (uartbootsend (kernel, baudrate))
+					quit(1);
+				break;
+			} else
+				write (1, buf, n);
+		}
+	}
+
+	console:;
+
+	fprintf (stderr, "press ctrl+] to quit\r\n");
+	while (1) {
+		if (poll (pollfds, 2, -1) <= 0)
+			continue;
+		if (pollfds[0].revents & POLLIN) {
+			if ((n = read (0, buf, sizeof(buf))) <= 0)
+				break;
+			if (memchr (buf, QUITKEY, n))
+				break;
+			write (ttyfd, buf, n);
+		}
+		if (pollfds[1].revents & POLLIN) {
+			if ((n = read (ttyfd, buf, sizeof(buf))) < 0)
+				break;
+			write (1, buf, n);
+		}
+	}
+
+	quit(0);
+}
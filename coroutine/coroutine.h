@@ -0,0 +1,119 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// (c) William Fonkou Tambe
+
+#ifndef COROUTINE_H
+#define COROUTINE_H
+
+// Stackless coroutines (protothreads) used to run work
+// on a single core where code would otherwise busy-wait.
+// A coroutine is a function which resumes where it last yielded;
+// its local variables are not preserved across yields, hence state
+// that must survive a yield must live in a structure embedding
+// the coroutine.
+// Coroutines are not meant to be used by more than one core.
+// At most one CO_YIELD() or CO_WAIT_UNTIL() can be used per line.
+
+// Structure representing a coroutine.
+typedef struct coroutine {
+	// Resume point; null to start from the beginning.
+	void *lc;
+	// Function implementing the coroutine;
+	// null once the coroutine has exited.
+	unsigned long (*fn) (struct coroutine *);
+	// Next coroutine in the list run by coroutine_sched().
+	struct coroutine *nxt;
+	// Non-null while the coroutine is being run.
+	unsigned long running;
+} coroutine;
+
+// Values returned by a coroutine function.
+#define COROUTINE_YIELDED	0
+#define COROUTINE_EXITED	1
+
+#define __CO_CAT2__(a, b) a##b
+#define __CO_CAT__(a, b) __CO_CAT2__(a, b)
+#define __CO_LC__ __CO_CAT__(__co_lc_, __LINE__)
+
+// Must be used at the beginning of a coroutine function.
+#define CO_BEGIN(co) do {		\
+	if ((co)->lc)			\
+		goto *(co)->lc;		\
+} while (0)
+
+// Return to the scheduler; execution resumes after CO_YIELD()
+// the next time the coroutine gets run.
+#define CO_YIELD(co) do {			\
+	(co)->lc = &&__CO_LC__;			\
+	return COROUTINE_YIELDED;		\
+	__CO_LC__:;				\
+} while (0)
+
+// Yield until the condition given by the argument cond is true.
+#define CO_WAIT_UNTIL(co, cond) do {		\
+	(co)->lc = &&__CO_LC__;			\
+	__CO_LC__:				\
+	if (!(cond))				\
+		return COROUTINE_YIELDED;	\
+} while (0)
+
+// Must be used at the end of a coroutine function.
+#define CO_END(co) do {			\
+	(co)->lc = (void *)0;		\
+	return COROUTINE_EXITED;	\
+} while (0)
+
+// List of coroutines run by coroutine_sched().
+static coroutine *coroutine_list = (void *)0;
+
+// Add the coroutine given by the argument co to the list
+// of coroutines run by coroutine_sched(), using the function
+// given by the argument fn to implement it.
+static void coroutine_spawn (coroutine *co, unsigned long (*fn)(coroutine *)) {
+	co->lc = (void *)0;
+	co->fn = fn;
+	co->nxt = (void *)0;
+	co->running = 0;
+	coroutine **p = &coroutine_list;
+	while (*p)
+		p = &(*p)->nxt;
+	*p = co;
+}
+
+// Run once every coroutine in the list, except those already running;
+// which happens when a coroutine busy-waits and coroutine_sched()
+// gets called from within it.
+// It is meant to be used as the function called at busy points,
+// ie: hwdrvblkdev_isbsy, hwdrvchar_isbsy.
+static void coroutine_sched (void) {
+	// Coroutines that exited are removed from the list
+	// only by the outermost call, as nested calls could
+	// otherwise remove an entry that an outer call uses.
+	static unsigned long depth = 0;
+	++depth;
+	for (coroutine *co = coroutine_list; co; co = co->nxt) {
+		if (co->running || !co->fn)
+			continue;
+		co->running = 1;
+		if (co->fn(co) == COROUTINE_EXITED)
+			co->fn = (void *)0;
+		co->running = 0;
+	}
+	if (!--depth) {
+		coroutine **p = &coroutine_list;
+		while (*p) {
+			if (!(*p)->fn)
+				*p = (*p)->nxt;
+			else
+				p = &(*p)->nxt;
+		}
+	}
+}
+
+// Call coroutine_sched() until the coroutine given
+// by the argument co has exited.
+static void coroutine_join (coroutine *co) {
+	while (co->fn)
+		coroutine_sched();
+}
+
+#endif /* COROUTINE_H */
@@ -13,6 +13,8 @@
 #include <termios.h>
 // Used for nanosleep().
 #include <time.h>
+// Used for ttyspeed().
+#include <baudneg/ttyspeed.h>
 // Other includes.
 #include <stdint.h>
 #include <stdio.h>
@@ -114,7 +116,6 @@ struct termios /*term,*/ savedterm, origterm;
 struct pollfd pollfds[POLL_NFDS];
 #define POLL_EVENTS_FLAGS (POLLIN /*| POLLPRI | POLLRDNORM | POLLRDBAND*/)
 
-// TODO: Option to set tty speed ...
 // TODO: usage output should also show commands implemented. ie:
 // TODO: 	b: breakpoint
 // TODO: 	c: continuous run
@@ -132,7 +133,17 @@ void quit (int status) {
 int main (unsigned long argc, uint8_t** arg) {
 
 	if (argc < 2) {
-		fprintf (stderr, "usage: %s <path/to/tty>\n", arg[0]);
+		fprintf (stderr, "usage: %s <path/to/tty> [baudrate]\n", arg[0]);
+		return -1;
+	}
+
+	// The debug device baudrate is fixed by the hardware
+	// design, hence it is not negotiated, but it can be
+	// different from the default of 115200.
+	unsigned long baudrate = ((argc > 2) ? strtoul (arg[2], 0, 0) : 115200);
+	speed_t speed = ttyspeed (baudrate);
+	if (speed == B0) {
+		fprintf (stderr, "unsupported baudrate: %lu\n", baudrate);
 		return -1;
 	}
 
@@ -151,9 +162,9 @@ int main (unsigned long argc, uint8_t** arg) {
 		if (tcgetattr(ttyfd, &ttyconfig) == 0) {
 			// Set the tty to raw mode.
 			cfmakeraw(&ttyconfig);
-			// Set the tty bitrate to 115200.
-			if (cfsetispeed(&ttyconfig, B115200) == 0 &&
-				cfsetospeed(&ttyconfig, B115200) == 0) {
+			// Set the tty bitrate.
+			if (cfsetispeed(&ttyconfig, speed) == 0 &&
+				cfsetospeed(&ttyconfig, speed) == 0) {
 				// A read() blocks for a max of 1s until
 				// four characters have been received.
 				ttyconfig.c_cc[VMIN] = 4;
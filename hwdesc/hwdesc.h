@@ -0,0 +1,49 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// (c) William Fonkou Tambe
+
+#ifndef HWDESC_H
+#define HWDESC_H
+
+// Format of the hardware description which the BIOS passes
+// to the kernel through the environment variable HWDESCR,
+// holding its address; it describes what the BIOS probed,
+// so that the kernel does not need to probe it again.
+// The blob is an hwdesc followed by hwdesc.devcnt hwdesc_dev,
+// all fields being of the size of a pointer.
+// Fields only get appended to hwdesc, incrementing
+// HWDESC_VERSION, hence a reader must use hwdesc.hdrsz
+// to locate the hwdesc_dev, and must ignore fields
+// beyond the ones it knows about.
+
+#define HWDESC_MAGIC	0x43534448 /* "HDSC" in little-endian */
+#define HWDESC_VERSION	1
+
+typedef struct {
+	unsigned long magic; // HWDESC_MAGIC.
+	unsigned long version; // HWDESC_VERSION of the writer.
+	unsigned long hdrsz; // Byte size of this structure.
+	unsigned long sz; // Byte size of the whole blob.
+	unsigned long clkfreq; // Value from getclkfreq.
+	unsigned long icachesz; // Value from geticachesize.
+	unsigned long dcachesz; // Value from getdcachesize.
+	unsigned long tlbsz; // Value from gettlbsize.
+	unsigned long maxcorecnt; // Max count of cores serviced by the BIOS, ie: MAXCORECNT; cores are not probed, hence fewer may be present.
+	unsigned long uartaddr; // Address of the UART used as console.
+	unsigned long uartclkfreq; // Clock frequency of the UART.
+	unsigned long uartbaud; // Baudrate in use by the UART.
+	unsigned long blkdevaddr; // Address of the block device booted from.
+	unsigned long blkdevblkcnt; // Count of 512 bytes blocks of the block device.
+	unsigned long ramaddr; // Address of the RAM device where the kernel was loaded.
+	unsigned long ramsz; // Byte size of that RAM device.
+	unsigned long devcnt; // Count of hwdesc_dev following this structure.
+} hwdesc;
+
+// Device from the device table; fields have the same meaning as in hwdrvdevtbl.
+typedef struct {
+	unsigned long id;
+	unsigned long addr;
+	unsigned long mapsz;
+	signed long intridx;
+} hwdesc_dev;
+
+#endif /* HWDESC_H */
@@ -4,6 +4,67 @@
 #ifndef HWDRVBLKDEV_H
 #define HWDRVBLKDEV_H
 
+// Structure representing a block request
+// used with hwdrvblkdev_submit() and hwdrvblkdev_poll().
+typedef struct hwdrvblkdev_rqst {
+	// Next request in the chain, or null.
+	struct hwdrvblkdev_rqst *nxt;
+	// Buffer to read into or write from.
+	void *ptr;
+	// Index of the first block to transfer.
+	unsigned long idx;
+	// Count of blocks to transfer.
+	unsigned long cnt;
+	// Count of blocks transferred so far.
+	unsigned long done;
+	// Operation: HWDRVBLKDEV_READ or HWDRVBLKDEV_WRITE.
+	unsigned long op;
+	// Completion status: HWDRVBLKDEV_RQSTQUEUED,
+	// HWDRVBLKDEV_RQSTDONE or HWDRVBLKDEV_RQSTERROR.
+	signed long status;
+} hwdrvblkdev_rqst;
+
+// Request status.
+#define HWDRVBLKDEV_RQSTQUEUED	0
+#define HWDRVBLKDEV_RQSTDONE	1
+#define HWDRVBLKDEV_RQSTERROR	-1
+
+#ifdef HWDRVBLKDEV_STATS
+// When HWDRVBLKDEV_STATS is defined, the block device
+// carries the following counters in its field stats,
+// otherwise no code is generated for them.
+
+// Indexes in the field hwdrvblkdev_stats.hist.
+#define HWDRVBLKDEV_STATSINIT	0 /* hwdrvblkdev_init() calls */
+#define HWDRVBLKDEV_STATSREAD	1 /* READ command latencies */
+#define HWDRVBLKDEV_STATSWRITE	2 /* WRITE command latencies */
+#define HWDRVBLKDEV_STATSCPY	3 /* hwdrvblkdev_cpy() calls */
+
+typedef struct {
+	// Count of READ and WRITE commands issued.
+	unsigned long rdcnt, wrcnt;
+	// Count of blocks copied by hwdrvblkdev_cpy().
+	unsigned long cpycnt;
+	// Count of controller status reads having returned busy; the local
+	// spinning of hwdrvblkdev_isrdy() until a command is predicted
+	// to complete does not read the status, hence is not counted.
+	unsigned long bsycnt;
+	// Count of bytes copied through the memory window.
+	unsigned long long memcpybytes;
+	// Count of hwdrvblkdev_read() and hwdrvblkdev_write()
+	// calls resuming a block transfer.
+	unsigned long resumecnt;
+	// Histograms of the clock cycles taken per operation,
+	// where hist[op][i] counts the operations having
+	// taken from 2^i to (2^(i+1))-1 clock cycles.
+	unsigned long hist[4][8*__SIZEOF_POINTER__];
+} hwdrvblkdev_stats;
+
+#define HWDRVBLKDEV_STAT(...) __VA_ARGS__
+#else
+#define HWDRVBLKDEV_STAT(...)
+#endif
+
 // Structure representing a block device.
 // Before initializing the device using
 // init(), the field addr must be valid.
@@ -12,6 +73,42 @@ typedef struct {
 	void* addr;
 	// Capacity in block count.
 	unsigned long blkcnt;
+	// Request being processed, followed by
+	// the requests chained through its field nxt.
+	hwdrvblkdev_rqst *rqst;
+	// Non-null when a command for the block of
+	// the request being processed has been issued.
+	unsigned long rqstissued;
+	// Non-null when the memory window has been filled
+	// up with the data of the next block to write.
+	unsigned long rqstprefilled;
+	// Blocks per second achieved by the last hwdrvblkdev_cpy().
+	unsigned long cpybps;
+	// Index of the block presented in the memory window, or -1.
+	unsigned long winidx;
+	// Non-null between hwdrvblkdev_peek() and hwdrvblkdev_release().
+	unsigned long peeked;
+	// Command in progress issued by hwdrvblkdev_cmd(),
+	// or 0 if the controller status must be read right away.
+	unsigned long cmdop;
+	// Low bits of the clock cycle count when the command in progress was issued,
+	// when the controller status was last read busy, or else when the command
+	// was predicted to complete, and when to read the controller status next.
+	unsigned long cmdclk, lastpollclk, pollclk;
+	// Clock cycles to wait after the controller status read busy.
+	unsigned long backoff;
+	// Following fields are indexed by (op == HWDRVBLKDEV_WRITE).
+	// Running estimate of the command latency in clock cycles.
+	unsigned long lat[2];
+	// Count of commands completed, and of controller status reads done for them.
+	unsigned long opcnt[2], pollcnt[2];
+	// Sum of the clock cycles between the last busy controller status read,
+	// or else the predicted completion, and the controller status read seeing
+	// the command completed, bounding the latency overshoot.
+	unsigned long long overshoot[2];
+	#ifdef HWDRVBLKDEV_STATS
+	hwdrvblkdev_stats stats;
+	#endif
 } hwdrvblkdev;
 
 // Commands.
@@ -29,21 +126,127 @@ typedef struct {
 // Block size in bytes.
 #define BLKSZ 512
 
+#ifdef HWDRVBLKDEV_HOST
+// When built for the host, the source including this header
+// must implement the following functions modeling the controller
+// and the clock frequency.
+unsigned long hwdrvblkdev_host_ldst (unsigned long v, void *addr);
+unsigned long hwdrvblkdev_host_clkfreq (void);
+#define HWDRVBLKDEV_LDST(V, A) ({        \
+	typeof(V) *ldstv = &(V);       \
+	*ldstv = hwdrvblkdev_host_ldst (*ldstv, (A)); })
+#define HWDRVBLKDEV_LDSTSR(A) hwdrvblkdev_host_ldst (0, (A))
+#else
+// Issue the instruction ldst to the controller at the address given
+// by the argument A, using the value of the lvalue given by the
+// argument V, which gets set to the value returned by the controller.
+#define HWDRVBLKDEV_LDST(V, A) __asm__ __volatile__ ( \
+	"ldst %0, %1"                                 \
+	: "+r" (V)                                    \
+	: "r" (A)                                     \
+	: "memory")
+// Same as HWDRVBLKDEV_LDST() for commands where the value used is meaningless.
+#define HWDRVBLKDEV_LDSTSR(A) __asm__ __volatile__ ( \
+	"ldst %%sr, %0"                              \
+	:: "r" (A)                                   \
+	: "memory")
+#endif
+
+// Clock cycles get counted with getclkcyclecnt() which, along with its union
+// clkcyclecnt, must be implemented by the source including this header,
+// as done by bios.c and memtest.c, hence whether the host or the SoC
+// clock cycle counter is used is up to the includer.
+
+#ifdef HWDRVBLKDEV_STATS
+// Count the clock cycles given by the argument cycles
+// in the histogram of the operation op.
+static void hwdrvblkdev_statshist (hwdrvblkdev *dev, unsigned long op, unsigned long cycles) {
+	unsigned long i = 0;
+	while (cycles >>= 1)
+		++i;
+	++dev->stats.hist[op][i];
+}
+#endif
+
+// Return the clock frequency used to count clock cycles.
+static inline unsigned long hwdrvblkdev_clkfreq (void) {
+	#ifdef HWDRVBLKDEV_HOST
+	return hwdrvblkdev_host_clkfreq();
+	#else
+	unsigned long freq;
+	__asm__ __volatile__ ("getclkfreq %0\n" : "=r"(freq));
+	return freq;
+	#endif
+}
+
 // Function called before hwdrvblkdev_isrdy() returns busy (0).
 static void (*hwdrvblkdev_isbsy)(void) = (void *)0;
 
 // Read block device status.
 // Returns 1 if ready, 0 if busy, -1 if error/poweroff.
+// When a command issued by hwdrvblkdev_cmd() is in progress, the controller
+// status does not get read before the predicted completion of the command,
+// then gets read with exponential backoff, so as to spare the interconnect
+// which the other cores share; the latency measured on completion
+// updates the estimate used for the next command.
 static signed long hwdrvblkdev_isrdy (hwdrvblkdev *dev) {
+	unsigned long op = dev->cmdop;
+	unsigned long i = (op == HWDRVBLKDEV_WRITE);
+	unsigned long now = 0;
+	if (op) {
+		now = getclkcyclecnt().val;
+		// Spin locally until the controller status is worth reading.
+		if ((signed long)(now - dev->pollclk) < 0)
+			goto busy;
+		++dev->pollcnt[i];
+	}
 	unsigned long n = 0;
-	__asm__ __volatile__ (
-		"ldst %0, %1"
-		: "+r" (n)
-		: "r" (dev->addr+HWDRVBLKDEV_RESET)
-		: "memory");
-	if (n == HWDRVBLKDEV_POWEROFF || n == HWDRVBLKDEV_ERROR)
+	HWDRVBLKDEV_LDST (n, dev->addr+HWDRVBLKDEV_RESET);
+	if (n == HWDRVBLKDEV_POWEROFF || n == HWDRVBLKDEV_ERROR) {
+		dev->cmdop = 0;
 		return -1;
-	return ((n == HWDRVBLKDEV_READY) ? 1 : (hwdrvblkdev_isbsy ? (hwdrvblkdev_isbsy(), 0) : 0));
+	}
+	if (n == HWDRVBLKDEV_READY) {
+		if (op) {
+			unsigned long lat = (now - dev->cmdclk);
+			dev->lat[i] = (dev->lat[i] ? (dev->lat[i] + ((signed long)(lat - dev->lat[i])/8)) : lat);
+			HWDRVBLKDEV_STAT(hwdrvblkdev_statshist (dev, (i ? HWDRVBLKDEV_STATSWRITE : HWDRVBLKDEV_STATSREAD), lat));
+			dev->overshoot[i] += (now - dev->lastpollclk);
+			++dev->opcnt[i];
+			dev->cmdop = 0;
+		}
+		return 1;
+	}
+	HWDRVBLKDEV_STAT(++dev->stats.bsycnt);
+	if (op) {
+		dev->lastpollclk = now;
+		dev->pollclk = (now + dev->backoff);
+		if (dev->backoff < (dev->lat[i]/16))
+			dev->backoff *= 2;
+	}
+	busy:
+	if (hwdrvblkdev_isbsy)
+		hwdrvblkdev_isbsy();
+	return 0;
+}
+
+// Issue the command given by the argument op, either HWDRVBLKDEV_READ
+// or HWDRVBLKDEV_WRITE, with the value given by the argument v which is
+// the block index; its completion gets predicted for hwdrvblkdev_isrdy()
+// from the latency estimated for op, slightly early as a command
+// completing sooner would otherwise never lower the estimate.
+// Returns the value returned by the controller.
+static unsigned long hwdrvblkdev_cmd (hwdrvblkdev *dev, unsigned long op, unsigned long v) {
+	HWDRVBLKDEV_LDST (v, dev->addr+op);
+	HWDRVBLKDEV_STAT(++*((op == HWDRVBLKDEV_WRITE) ? &dev->stats.wrcnt : &dev->stats.rdcnt));
+	unsigned long now = getclkcyclecnt().val;
+	unsigned long lat = dev->lat[op == HWDRVBLKDEV_WRITE];
+	dev->cmdop = op;
+	dev->cmdclk = now;
+	dev->pollclk = (now + lat - (lat/8));
+	dev->lastpollclk = dev->pollclk;
+	dev->backoff = ((lat/64) ?: 1);
+	return v;
 }
 
 static void *hwdrvblkdev_read_ptr_saved;
@@ -58,40 +261,39 @@ static unsigned long hwdrvblkdev_write_idx_saved;
 // On success returns 1 otherwise 0.
 static unsigned long hwdrvblkdev_init (hwdrvblkdev *dev, unsigned long idx) {
 	void* addr = dev->addr;
+	HWDRVBLKDEV_STAT(unsigned long long startclkcyclecnt = getclkcyclecnt().val);
+	dev->cmdop = 0;
 	// Reset the controller.
-	__asm__ __volatile__ (
-		"ldst %0, %1"
-		: "+r" ((unsigned long){1})
-		: "r" (addr+HWDRVBLKDEV_RESET)
-		: "memory");
+	HWDRVBLKDEV_LDST ((unsigned long){1}, addr+HWDRVBLKDEV_RESET);
 	// Read status until ready is returned.
 	signed long isrdy;
 	do {
 		if ((isrdy = hwdrvblkdev_isrdy (dev)) < 0)
-			return (dev->blkcnt = 0);
+			goto error;
 	} while (!isrdy);
 	// Retrieve the capacity.
-	dev->blkcnt = idx;
-	__asm__ __volatile__ (
-		"ldst %0, %1"
-		: "+r" (dev->blkcnt)
-		: "r" (addr+HWDRVBLKDEV_READ)
-		: "memory");
+	dev->blkcnt = hwdrvblkdev_cmd (dev, HWDRVBLKDEV_READ, idx);
 	// Read status until ready is returned.
 	do {
 		if ((isrdy = hwdrvblkdev_isrdy (dev)) < 0)
-			return (dev->blkcnt = 0);
+			goto error;
 	} while (!isrdy);
 	// Present the loaded data in the physical memory.
-	__asm__ __volatile__ (
-		"ldst %%sr, %0"
-		:: "r" (addr+HWDRVBLKDEV_SWAP)
-		: "memory");
+	HWDRVBLKDEV_LDSTSR (addr+HWDRVBLKDEV_SWAP);
 	hwdrvblkdev_read_ptr_saved = (void *)-1;
 	hwdrvblkdev_read_idx_saved = -1;
 	hwdrvblkdev_write_ptr_saved = (void *)-1;
 	hwdrvblkdev_write_idx_saved = -1;
+	dev->rqst = 0;
+	dev->rqstissued = 0;
+	dev->rqstprefilled = 0;
+	dev->winidx = idx;
+	dev->peeked = 0;
+	HWDRVBLKDEV_STAT(hwdrvblkdev_statshist (dev, HWDRVBLKDEV_STATSINIT, getclkcyclecnt().val - startclkcyclecnt));
 	return 1;
+	error:
+	HWDRVBLKDEV_STAT(hwdrvblkdev_statshist (dev, HWDRVBLKDEV_STATSINIT, getclkcyclecnt().val - startclkcyclecnt));
+	return (dev->blkcnt = 0);
 }
 
 void *memcpy (void *dest, const void *src, size_t count);
@@ -102,71 +304,92 @@ void *memcpy (void *dest, const void *src, size_t count);
 // The block device must be ready. Returns 1 if block was read, otherwise 0 indicating retry is needed.
 static unsigned long hwdrvblkdev_read (hwdrvblkdev *dev, void* ptr, unsigned long idx, unsigned long nxt) {
 	void* addr = dev->addr;
-	if (ptr == hwdrvblkdev_read_ptr_saved && idx == hwdrvblkdev_read_idx_saved)
+	if (ptr == hwdrvblkdev_read_ptr_saved && idx == hwdrvblkdev_read_idx_saved) {
+		HWDRVBLKDEV_STAT(++dev->stats.resumecnt);
 		goto resume;
+	}
 	hwdrvblkdev_write_ptr_saved = (void *)-1;
 	hwdrvblkdev_write_idx_saved = -1;
 	// Initiate the block read.
-	__asm__ __volatile__ (
-		"ldst %0, %1"
-		: "+r" ((unsigned long){idx})
-		: "r" (addr+HWDRVBLKDEV_READ)
-		: "memory");
+	hwdrvblkdev_cmd (dev, HWDRVBLKDEV_READ, idx);
 	hwdrvblkdev_read_ptr_saved = ptr;
 	hwdrvblkdev_read_idx_saved = idx;
 	return 0;
 	resume:
 	// Present the loaded data in the physical memory.
-	__asm__ __volatile__ (
-		"ldst %%sr, %0"
-		:: "r" (addr+HWDRVBLKDEV_SWAP)
-		: "memory");
+	HWDRVBLKDEV_LDSTSR (addr+HWDRVBLKDEV_SWAP);
+	dev->winidx = idx;
 	if (nxt) {
 		idx += 1;
 		// Initiate the next block read.
-		__asm__ __volatile__ (
-			"ldst %0, %1"
-			: "+r" ((unsigned long){idx})
-			: "r" (addr+HWDRVBLKDEV_READ)
-			: "memory");
-		hwdrvblkdev_read_ptr_saved = (ptr + BLKSZ);
+		hwdrvblkdev_cmd (dev, HWDRVBLKDEV_READ, idx);
+		// The window does not move when used by hwdrvblkdev_peek().
+		hwdrvblkdev_read_ptr_saved = ((ptr == addr) ? ptr : (ptr + BLKSZ));
 		hwdrvblkdev_read_idx_saved = idx;
 	} else {
 		hwdrvblkdev_read_ptr_saved = (void *)-1;
 		hwdrvblkdev_read_idx_saved = -1;
 	}
 	// Retrieve loaded data.
-	memcpy (ptr, addr, BLKSZ);
+	if (ptr != addr) {
+		memcpy (ptr, addr, BLKSZ);
+		HWDRVBLKDEV_STAT(dev->stats.memcpybytes += BLKSZ);
+	}
 	return 1;
 }
 
+// Present in the memory window the block at the index given by the
+// argument idx, and return a pointer to it within the window, which remains
+// valid until hwdrvblkdev_release(); unlike hwdrvblkdev_read(), the block
+// does not get copied, which is best when only a few of its fields are needed,
+// or when its data gets transformed anyway.
+// Argument nxt is used like with hwdrvblkdev_read(), the next block read
+// going into the controller buffer and leaving the window untouched.
+// No command is issued if the block is already presented in the window,
+// which is the case after hwdrvblkdev_init() for the block it loaded.
+// Returns null indicating retry is needed, in which case the block device
+// must be ready before calling this function again.
+static void *hwdrvblkdev_peek (hwdrvblkdev *dev, unsigned long idx, unsigned long nxt) {
+	if (idx != dev->winidx && !hwdrvblkdev_read (dev, dev->addr, idx, nxt))
+		return (void *)0;
+	dev->peeked = 1;
+	return dev->addr;
+}
+
+// Release the block obtained with hwdrvblkdev_peek(); the pointer it
+// returned must no longer be used, and the driver may swap the window.
+// hwdrvblkdev_write() and hwdrvblkdev_cpy() must not be used between
+// hwdrvblkdev_peek() and hwdrvblkdev_release(), while hwdrvblkdev_poll()
+// holds off pending requests.
+static void hwdrvblkdev_release (hwdrvblkdev *dev) {
+	dev->peeked = 0;
+}
+
 // Write a block to the block device from the buffer given by the argument ptr.
 // Argument nxt is used to fill controller up with next data while writing a block.
 // The index of the block to write is given by the argument idx, where a block is BLKSZ bytes.
 // The block device must be ready.
 static void hwdrvblkdev_write (hwdrvblkdev *dev, void* ptr, unsigned long idx, unsigned long nxt) {
 	void* addr = dev->addr;
-	if (ptr == hwdrvblkdev_write_ptr_saved && idx == hwdrvblkdev_write_idx_saved)
+	if (ptr == hwdrvblkdev_write_ptr_saved && idx == hwdrvblkdev_write_idx_saved) {
+		HWDRVBLKDEV_STAT(++dev->stats.resumecnt);
 		goto resume;
+	}
 	hwdrvblkdev_read_ptr_saved = (void *)-1;
 	hwdrvblkdev_read_idx_saved = -1;
+	dev->winidx = -1;
 	memcpy (addr, ptr, BLKSZ);
+	HWDRVBLKDEV_STAT(dev->stats.memcpybytes += BLKSZ);
 	resume:
 	// Present the data to the controller.
-	__asm__ __volatile__ (
-		"ldst %%sr, %0"
-		:: "r" (addr+HWDRVBLKDEV_SWAP)
-		: "memory");
+	HWDRVBLKDEV_LDSTSR (addr+HWDRVBLKDEV_SWAP);
 	// Initiate the block write.
-	__asm__ __volatile__ (
-		"ldst %0, %1"
-		: "+r" ((unsigned long){idx})
-		: "r" (addr+HWDRVBLKDEV_WRITE)
-		: "memory");
+	hwdrvblkdev_cmd (dev, HWDRVBLKDEV_WRITE, idx);
 	if (nxt) {
 		ptr += BLKSZ;
 		// Fill controller up with next data to write.
 		memcpy (addr, ptr, BLKSZ);
+		HWDRVBLKDEV_STAT(dev->stats.memcpybytes += BLKSZ);
 		hwdrvblkdev_write_ptr_saved = ptr;
 		hwdrvblkdev_write_idx_saved = (idx + 1);
 	} else {
@@ -181,7 +404,10 @@ static void hwdrvblkdev_write (hwdrvblkdev *dev, void* ptr, unsigned long idx, u
 // given by the arguments dstidx and srcidx, while the count of blocks
 // to copy is given by the argument cnt. The fact that the destination
 // and source may overlap is taken into account.
-// Returns the count of blocks that could be copied.
+// The copy is not pipelined, as the controller rejects a command
+// while busy, and a block must be in its buffer to be written.
+// The field dev->cpybps gets set to the blocks per second achieved.
+// Returns the count of blocks that could be copied, or 0 on error.
 static unsigned long hwdrvblkdev_cpy (hwdrvblkdev *dev, unsigned long dstidx, unsigned long srcidx, unsigned long cnt) {
 	if (!cnt)
 		return 0;
@@ -189,6 +415,8 @@ static unsigned long hwdrvblkdev_cpy (hwdrvblkdev *dev, unsigned long dstidx, un
 	hwdrvblkdev_read_idx_saved = -1;
 	hwdrvblkdev_write_ptr_saved = (void *)-1;
 	hwdrvblkdev_write_idx_saved = -1;
+	// The block presented may get overwritten.
+	dev->winidx = -1;
 	// Variable used to determine whether to copy blocks from
 	// the top or bottom to avoid overwriting data when the
 	// destination and source overlap.
@@ -198,34 +426,157 @@ static unsigned long hwdrvblkdev_cpy (hwdrvblkdev *dev, unsigned long dstidx, un
 		dstidx += cnt;
 		srcidx += cnt;
 	}
-	void* addr = dev->addr;
+	unsigned long long startclkcyclecnt = getclkcyclecnt().val;
 	do {
 		// Initiate the block read.
-		__asm__ __volatile__ (
-			"ldst %0, %1"
-			: "+r" ((unsigned long){x?--srcidx:srcidx++})
-			: "r" (addr+HWDRVBLKDEV_READ)
-			: "memory");
+		hwdrvblkdev_cmd (dev, HWDRVBLKDEV_READ, (x?--srcidx:srcidx++));
 		// Read status until ready is returned.
 		signed long isrdy;
 		do {
-			if ((isrdy = hwdrvblkdev_isrdy (dev)) < 0)
-				return 0;
+			if ((isrdy = hwdrvblkdev_isrdy (dev)) < 0) {
+				ret = 0;
+				goto done;
+			}
 		} while (!isrdy);
 		// Initiate the block write.
-		__asm__ __volatile__ (
-			"ldst %0, %1"
-			: "+r" ((unsigned long){x?--dstidx:dstidx++})
-			: "r" (addr+HWDRVBLKDEV_WRITE)
-			: "memory");
+		hwdrvblkdev_cmd (dev, HWDRVBLKDEV_WRITE, (x?--dstidx:dstidx++));
 		// Read status until ready is returned.
 		do {
-			if ((isrdy = hwdrvblkdev_isrdy (dev)) < 0)
-				return 0;
+			if ((isrdy = hwdrvblkdev_isrdy (dev)) < 0) {
+				ret = 0;
+				goto done;
+			}
 		} while (!isrdy);
 		++ret;
 	} while (--cnt);
+	done:;
+	unsigned long long cycles = (getclkcyclecnt().val - startclkcyclecnt);
+	dev->cpybps = (cycles ? ((ret * (unsigned long long)hwdrvblkdev_clkfreq()) / cycles) : 0);
+	HWDRVBLKDEV_STAT(dev->stats.cpycnt += ret, hwdrvblkdev_statshist (dev, HWDRVBLKDEV_STATSCPY, cycles));
 	return ret;
 }
 
+// Requests are an alternative to hwdrvblkdev_read() and hwdrvblkdev_write()
+// which must not be used while requests are pending.
+// A request is submitted with hwdrvblkdev_submit(), then hwdrvblkdev_poll()
+// is called to advance it; each call reads the device status once, and when
+// the device is ready, completes the block in progress and issues the command
+// for the next block, crossing into the next chained request if needed.
+// Pending requests get discarded by hwdrvblkdev_init().
+
+// Retire the completed requests at the head of
+// the queue and return the request being processed.
+static hwdrvblkdev_rqst *hwdrvblkdev_rqsthead (hwdrvblkdev *dev) {
+	hwdrvblkdev_rqst *r;
+	while ((r = dev->rqst) && r->done >= r->cnt) {
+		r->status = HWDRVBLKDEV_RQSTDONE;
+		dev->rqst = r->nxt;
+	}
+	return r;
+}
+
+// Issue the command for the block at index r->done of the request r.
+// The block device must be ready.
+static void hwdrvblkdev_rqstissue (hwdrvblkdev *dev, hwdrvblkdev_rqst *r) {
+	void* addr = dev->addr;
+	if (r->op == HWDRVBLKDEV_WRITE) {
+		dev->winidx = -1;
+		if (!dev->rqstprefilled) {
+			memcpy (addr, r->ptr + (r->done*BLKSZ), BLKSZ);
+			HWDRVBLKDEV_STAT(dev->stats.memcpybytes += BLKSZ);
+		}
+		// Present the data to the controller.
+		HWDRVBLKDEV_LDSTSR (addr+HWDRVBLKDEV_SWAP);
+	}
+	// Initiate the block read or write.
+	hwdrvblkdev_cmd (dev, r->op, (r->idx + r->done));
+	dev->rqstissued = 1;
+	dev->rqstprefilled = 0;
+	if (r->op == HWDRVBLKDEV_WRITE) {
+		// Fill controller up with next data to write.
+		unsigned long i = (r->done + 1);
+		while (r && i >= r->cnt)
+			if ((r = r->nxt))
+				i = r->done;
+		if (r && r->op == HWDRVBLKDEV_WRITE) {
+			memcpy (addr, r->ptr + (i*BLKSZ), BLKSZ);
+			HWDRVBLKDEV_STAT(dev->stats.memcpybytes += BLKSZ);
+			dev->rqstprefilled = 1;
+		}
+	}
+}
+
+// Advance the requests submitted to the block device.
+// Returns 1 if there is no request pending, 0 if requests are pending,
+// -1 on device error in which case all pending requests get
+// the status HWDRVBLKDEV_RQSTERROR and hwdrvblkdev_init() must be used.
+static signed long hwdrvblkdev_poll (hwdrvblkdev *dev) {
+	hwdrvblkdev_rqst *r = hwdrvblkdev_rqsthead (dev);
+	if (!r)
+		return 1;
+	if (dev->peeked)
+		return 0;
+	signed long isrdy = hwdrvblkdev_isrdy (dev);
+	if (isrdy < 0) {
+		do r->status = HWDRVBLKDEV_RQSTERROR;
+			while ((r = r->nxt));
+		dev->rqst = 0;
+		dev->rqstissued = 0;
+		dev->rqstprefilled = 0;
+		return -1;
+	}
+	if (!isrdy)
+		return 0;
+	if (!dev->rqstissued) {
+		hwdrvblkdev_rqstissue (dev, r);
+		return 0;
+	}
+	// The command for the block r->done has completed.
+	void* addr = dev->addr;
+	void* ptr = (r->ptr + (r->done*BLKSZ));
+	unsigned long op = r->op;
+	++r->done;
+	dev->rqstissued = 0;
+	hwdrvblkdev_rqst *n = hwdrvblkdev_rqsthead (dev);
+	if (op == HWDRVBLKDEV_READ) {
+		// Present the loaded data in the physical memory.
+		HWDRVBLKDEV_LDSTSR (addr+HWDRVBLKDEV_SWAP);
+		dev->winidx = (r->idx + r->done - 1);
+		// Initiate the next block read while retrieving loaded data;
+		// a write must wait for loaded data to have been retrieved.
+		if (n && n->op == HWDRVBLKDEV_READ)
+			hwdrvblkdev_rqstissue (dev, n);
+		// Retrieve loaded data.
+		memcpy (ptr, addr, BLKSZ);
+		HWDRVBLKDEV_STAT(dev->stats.memcpybytes += BLKSZ);
+		if (n && n->op == HWDRVBLKDEV_WRITE)
+			hwdrvblkdev_rqstissue (dev, n);
+	} else if (n)
+		hwdrvblkdev_rqstissue (dev, n);
+	return !n;
+}
+
+// Submit the request given by the argument rqst, and the requests
+// chained to it through its field nxt, for processing after the requests
+// already pending; the fields done and status get initialized by this function.
+static void hwdrvblkdev_submit (hwdrvblkdev *dev, hwdrvblkdev_rqst *rqst) {
+	hwdrvblkdev_rqst **p = &dev->rqst;
+	while (*p)
+		p = &(*p)->nxt;
+	*p = rqst;
+	do {
+		rqst->done = 0;
+		rqst->status = HWDRVBLKDEV_RQSTQUEUED;
+	} while ((rqst = rqst->nxt));
+	hwdrvblkdev_poll (dev);
+}
+
+// Call hwdrvblkdev_poll() until the request given
+// by the argument rqst is no longer queued.
+// Returns the status of the request.
+static signed long hwdrvblkdev_wait (hwdrvblkdev *dev, hwdrvblkdev_rqst *rqst) {
+	while (rqst->status == HWDRVBLKDEV_RQSTQUEUED && !hwdrvblkdev_poll (dev));
+	return rqst->status;
+}
+
 #endif /* HWDRVBLKDEV_H */
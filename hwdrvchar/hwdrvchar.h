@@ -15,6 +15,14 @@ typedef struct {
 	unsigned long bufsz;
 	// Frequency of the device input clk.
 	unsigned long clkfreq;
+	// Count of bytes known to be writable to the transmit buffer,
+	// and readable from the receive buffer; since the device only
+	// drains the former and fills the latter, the buffer usage gets
+	// queried only once these credits run out, assuming this driver
+	// is the only one moving bytes through the device; otherwise,
+	// hwdrvchar_dropcredits() must be called whenever another driver
+	// may have used the device since this driver last did.
+	unsigned long txcredit, rxcredit;
 } hwdrvchar;
 
 // Commands.
@@ -22,6 +30,26 @@ typedef struct {
 #define HWDRVCHAR_CMDSETINTERRUPT   1
 #define HWDRVCHAR_CMDSETSPEED       2
 
+// Function called while hwdrvchar_init() waits for
+// the transmit buffer to be empty.
+static void (*hwdrvchar_isbsy)(void) = (void *)0;
+
+// Set the speed to use when sending and receiving bytes
+// using the baudrate given as argument; dev->clkfreq must be valid.
+// Bytes in the transmit buffer get sent at the new speed.
+static inline void hwdrvchar_setspeed (hwdrvchar *dev, unsigned long baudrate) {
+	// Command HWDRVCHAR_CMDSETSPEED == 2 to set
+	// the speed to use when sending and receiving bytes.
+	// The encoding of a command and its argument
+	// is as follow: |cmd: 2bits|arg: (ARCHBITSZ-2)bits|
+	baudrate = ((HWDRVCHAR_CMDSETSPEED<<((sizeof(unsigned long)*8)-2)) + (dev->clkfreq/baudrate));
+	__asm__ __volatile__ (
+		"ldst %0, %1"
+		: "+r" (baudrate)
+		: "r" (dev->addr)
+		: "memory");
+}
+
 // Initialize the UART device at the address given through
 // the argument dev->addr using the baudrate given as argument.
 // The field dev->bufsz get initialized by this function.
@@ -32,12 +60,17 @@ static void hwdrvchar_init (hwdrvchar *dev, unsigned long baudrate) {
 	// The encoding of a command and its argument
 	// is as follow: |cmd: 2bits|arg: (ARCHBITSZ-2)bits|
 	unsigned long bufferusage = ((HWDRVCHAR_CMDGETBUFFERUSAGE<<((sizeof(unsigned long)*8)-2)) | 1);
-	do __asm__ __volatile__ (
-		"ldst %0, %1"
-		: "+r" (bufferusage)
-		: "r" (addr)
-		: "memory");
-		while (bufferusage); // Wait for the transmit buffer to be empty.
+	while (1) {
+		__asm__ __volatile__ (
+			"ldst %0, %1"
+			: "+r" (bufferusage)
+			: "r" (addr)
+			: "memory");
+		if (!bufferusage) // Wait for the transmit buffer to be empty.
+			break;
+		if (hwdrvchar_isbsy)
+			hwdrvchar_isbsy();
+	}
 	// Command HWDRVCHAR_CMDSETSPEED == 2 to retrieve
 	// the clock frequency used by the UART device.
 	// The encoding of a command and its argument
@@ -48,16 +81,7 @@ static void hwdrvchar_init (hwdrvchar *dev, unsigned long baudrate) {
 		: "+r" (dev->clkfreq)
 		: "r" (addr)
 		: "memory");
-	// Command HWDRVCHAR_CMDSETSPEED == 2 to set
-	// the speed to use when sending and receiving bytes.
-	// The encoding of a command and its argument
-	// is as follow: |cmd: 2bits|arg: (ARCHBITSZ-2)bits|
-	baudrate = ((HWDRVCHAR_CMDSETSPEED<<((sizeof(unsigned long)*8)-2)) + (dev->clkfreq/baudrate));
-	__asm__ __volatile__ (
-		"ldst %0, %1"
-		: "+r" (baudrate)
-		: "r" (addr)
-		: "memory");
+	hwdrvchar_setspeed (dev, baudrate);
 	// Command HWDRVCHAR_CMDSETINTERRUPT == 1 to retrieve
 	// the size in bytes of the UART transmit
 	// and receive buffer.
@@ -69,10 +93,22 @@ static void hwdrvchar_init (hwdrvchar *dev, unsigned long baudrate) {
 		: "+r" (dev->bufsz)
 		: "r" (addr)
 		: "memory");
+	// The transmit buffer was emptied above.
+	dev->txcredit = dev->bufsz;
+	dev->rxcredit = 0;
+}
+
+// Forget the credits, such that the buffer usage gets queried
+// by the next hwdrvchar_read() and hwdrvchar_write(); to be used
+// when another driver may have moved bytes through the device.
+static inline void hwdrvchar_dropcredits (hwdrvchar *dev) {
+	dev->txcredit = 0;
+	dev->rxcredit = 0;
 }
 
 // Return the count of bytes that can be read
-// from the UART device without blocking.
+// from the UART device without blocking;
+// dev->rxcredit gets refreshed with it.
 static inline unsigned long hwdrvchar_readable (hwdrvchar *dev) {
 	// Command HWDRVCHAR_CMDGETBUFFERUSAGE == 0 to retrieve
 	// the number of bytes in the UART receive buffer.
@@ -84,35 +120,41 @@ static inline unsigned long hwdrvchar_readable (hwdrvchar *dev) {
 		: "+r" (bufferusage)
 		: "r" (dev->addr)
 		: "memory");
-	return bufferusage;
+	return (dev->rxcredit = bufferusage);
 }
 
 // Read from the UART device into the buffer given by the
 // argument ptr, the byte amount given by the argument sz.
 // Return the byte amount read.
+// The device gets queried only when dev->rxcredit runs out.
 static unsigned long hwdrvchar_read (hwdrvchar *dev, void *ptr, unsigned long sz) {
-	void* addr = dev->addr;
+	volatile unsigned char *addr = dev->addr;
+	unsigned char *p = ptr;
 	unsigned long cnt = 0;
 	while (sz) {
-		unsigned long n = hwdrvchar_readable(dev);
-		if (!n)
+		unsigned long n = dev->rxcredit;
+		if (!n && !(n = hwdrvchar_readable(dev)))
 			return cnt;
-		if (sz >= n)
-			sz -= n;
-		else {
+		if (n > sz)
 			n = sz;
-			sz = 0;
-		}
+		sz -= n;
 		cnt += n;
-		do {
-			*(unsigned char *)(ptr++) = *((volatile unsigned char *)addr);
-		} while (--n);
+		dev->rxcredit -= n;
+		for (; n >= 4; n -= 4, p += 4) {
+			p[0] = *addr;
+			p[1] = *addr;
+			p[2] = *addr;
+			p[3] = *addr;
+		}
+		while (n--)
+			*p++ = *addr;
 	}
 	return cnt;
 }
 
 // Return the count of bytes that can be written
-// to the UART device without blocking.
+// to the UART device without blocking;
+// dev->txcredit gets refreshed with it.
 static inline unsigned long hwdrvchar_writable (hwdrvchar *dev) {
 	// Command HWDRVCHAR_CMDGETBUFFERUSAGE == 0 to retrieve
 	// the number of bytes in the UART transmit buffer.
@@ -124,29 +166,34 @@ static inline unsigned long hwdrvchar_writable (hwdrvchar *dev) {
 		: "+r" (bufferusage)
 		: "r" (dev->addr)
 		: "memory");
-	return (dev->bufsz - bufferusage);
+	return (dev->txcredit = (dev->bufsz - bufferusage));
 }
 
 // Write to the UART device from the buffer given by the
 // argument ptr, the byte amount given by the argument sz.
 // Return the byte amount written.
+// The device gets queried only when dev->txcredit runs out.
 static unsigned long hwdrvchar_write (hwdrvchar *dev, void *ptr, unsigned long sz) {
-	void* addr = dev->addr;
+	volatile unsigned char *addr = dev->addr;
+	unsigned char *p = ptr;
 	unsigned long cnt = 0;
 	while (sz) {
-		unsigned long n = hwdrvchar_writable(dev);
-		if (!n)
+		unsigned long n = dev->txcredit;
+		if (!n && !(n = hwdrvchar_writable(dev)))
 			return cnt;
-		if (sz >= n)
-			sz -= n;
-		else {
+		if (n > sz)
 			n = sz;
-			sz = 0;
-		}
+		sz -= n;
 		cnt += n;
-		do {
-			*((volatile unsigned char *)addr) = *(unsigned char *)(ptr++);
-		} while (--n);
+		dev->txcredit -= n;
+		for (; n >= 4; n -= 4, p += 4) {
+			*addr = p[0];
+			*addr = p[1];
+			*addr = p[2];
+			*addr = p[3];
+		}
+		while (n--)
+			*addr = *p++;
 	}
 	return cnt;
 }
@@ -168,4 +215,60 @@ static inline void hwdrvchar_interrupt (hwdrvchar *dev, unsigned long threshold)
 		: "memory");
 }
 
+// Structure used to moderate the receive interrupt adaptively: the threshold
+// to use with hwdrvchar_interrupt() is raised as the observed byte rate rises,
+// such that an interrupt fires about once per the field budget, and drops back
+// to 1 once traffic goes idle; bytes which do not reach the threshold must be
+// received by polling the UART every budget, which is the idle-flush timeout,
+// so that they wait at most about a budget.
+typedef struct {
+	// Clock cycles that a received byte is allowed to wait.
+	unsigned long budget;
+	// Max threshold, which must leave room in the receive buffer
+	// for the bytes arriving while the interrupt gets serviced.
+	unsigned long max;
+	// Threshold to use with hwdrvchar_interrupt().
+	unsigned long threshold;
+	// Moving average of the bytes received per budget, in 1/16th.
+	unsigned long rate;
+	// Clock cycle count when bytes were last received.
+	unsigned long long lastclk;
+} hwdrvchar_rxmod;
+
+// Initialize the moderation given by the argument m,
+// using the argument budget and max for its fields.
+static inline void hwdrvchar_rxmod_init (hwdrvchar_rxmod *m, unsigned long budget, unsigned long max) {
+	*m = (hwdrvchar_rxmod){.budget = budget, .max = (max ? max : 1), .threshold = 1};
+}
+
+// Account for the byte amount given by the argument n received at the clock
+// cycle count given by the argument now, either after an interrupt or polling.
+// Returns the threshold to use with hwdrvchar_interrupt().
+static unsigned long hwdrvchar_rxmod_update (hwdrvchar_rxmod *m, unsigned long n, unsigned long long now) {
+	// The full clock cycle count is used, since its lower bits wrap within seconds,
+	// after which a long idle time would be seen as a burst; the delta saturates
+	// at the budget, past which its value does not matter.
+	unsigned long long d = (now - m->lastclk);
+	unsigned long dt = ((d < m->budget) ? (unsigned long)d : m->budget);
+	if (!n) {
+		// Idle traffic: favor latency.
+		if (dt >= m->budget) {
+			m->rate = 0;
+			m->threshold = 1;
+		}
+		return m->threshold;
+	}
+	m->lastclk = now;
+	// Bytes per budget observed since bytes were last received;
+	// when traffic was idle, the bytes are assumed to have arrived within a budget.
+	unsigned long long r = ((dt >= m->budget) ? ((unsigned long long)n << 4) :
+		((((unsigned long long)n * m->budget) << 4) / (dt ? dt : 1)));
+	if (r > ((unsigned long long)m->max << 4))
+		r = ((unsigned long long)m->max << 4);
+	m->rate = ((m->rate - (m->rate >> 2)) + (r >> 2));
+	unsigned long t = (m->rate >> 4);
+	m->threshold = ((t < 1) ? 1 : (t > m->max) ? m->max : t);
+	return m->threshold;
+}
+
 #endif /* HWDRVCHAR_H */
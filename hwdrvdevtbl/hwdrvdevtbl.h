@@ -91,4 +91,85 @@ static void hwdrvdevtbl_find (hwdrvdevtbl *dev, unsigned long (*cb)(hwdrvdevtbl
 	}
 }
 
+// Max count of devices in the index built by hwdrvdevtbl_scan().
+#ifndef HWDRVDEVTBL_IDXMAX
+#define HWDRVDEVTBL_IDXMAX 32
+#endif
+
+// Device described in the index built by hwdrvdevtbl_scan();
+// its fields have the same meaning as in hwdrvdevtbl.
+typedef struct {
+	unsigned long id;
+	void* addr;
+	unsigned long mapsz;
+	signed long intridx;
+} hwdrvdevtbl_ent;
+
+// Index of the device table, so that lookups do not walk it.
+static struct {
+	unsigned long cnt; // Null until the index is built.
+	hwdrvdevtbl_ent e[HWDRVDEVTBL_IDXMAX]; // In device table order, hence sorted by address.
+	unsigned char byid[HWDRVDEVTBL_IDXMAX]; // Indexes in e[] sorted by id, then by address.
+} hwdrvdevtbl_idx;
+
+// Build the device table index, walking the device table once;
+// devices beyond HWDRVDEVTBL_IDXMAX are not indexed.
+static void hwdrvdevtbl_scan (void) {
+	hwdrvdevtbl dev = {.e = (devtblentry *)0};
+	unsigned long cnt = 0;
+	while (cnt < HWDRVDEVTBL_IDXMAX && (hwdrvdevtbl_find (&dev, (void *)-1), dev.mapsz)) {
+		hwdrvdevtbl_idx.e[cnt] = (hwdrvdevtbl_ent){
+			.id = dev.id, .addr = dev.addr, .mapsz = dev.mapsz, .intridx = dev.intridx};
+		// Insertion sort, which is stable, into byid[].
+		unsigned long i = cnt;
+		while (i && hwdrvdevtbl_idx.e[hwdrvdevtbl_idx.byid[i-1]].id > dev.id) {
+			hwdrvdevtbl_idx.byid[i] = hwdrvdevtbl_idx.byid[i-1];
+			--i;
+		}
+		hwdrvdevtbl_idx.byid[i] = cnt++;
+	}
+	hwdrvdevtbl_idx.cnt = cnt;
+}
+
+// Return the device from the index which is the nth, as given by the argument n
+// starting from 0, among the devices which DeviceID is given by the argument id;
+// null is returned if there is no such device.
+// The index gets built on first use.
+static hwdrvdevtbl_ent *hwdrvdevtbl_nth (unsigned long id, unsigned long n) {
+	if (!hwdrvdevtbl_idx.cnt)
+		hwdrvdevtbl_scan();
+	unsigned long lo = 0, hi = hwdrvdevtbl_idx.cnt;
+	while (lo < hi) {
+		unsigned long mid = ((lo + hi) / 2);
+		if (hwdrvdevtbl_idx.e[hwdrvdevtbl_idx.byid[mid]].id < id)
+			lo = (mid + 1);
+		else
+			hi = mid;
+	}
+	if ((lo += n) >= hwdrvdevtbl_idx.cnt)
+		return (hwdrvdevtbl_ent *)0;
+	hwdrvdevtbl_ent *e = &hwdrvdevtbl_idx.e[hwdrvdevtbl_idx.byid[lo]];
+	return ((e->id == id) ? e : (hwdrvdevtbl_ent *)0);
+}
+
+// Return the device from the index which mapping contains
+// the address given by the argument addr, or null if none does.
+// The index gets built on first use.
+static hwdrvdevtbl_ent *hwdrvdevtbl_at (void *addr) {
+	if (!hwdrvdevtbl_idx.cnt)
+		hwdrvdevtbl_scan();
+	unsigned long lo = 0, hi = hwdrvdevtbl_idx.cnt;
+	while (lo < hi) {
+		unsigned long mid = ((lo + hi) / 2);
+		if (hwdrvdevtbl_idx.e[mid].addr <= addr)
+			lo = (mid + 1);
+		else
+			hi = mid;
+	}
+	if (!lo)
+		return (hwdrvdevtbl_ent *)0;
+	hwdrvdevtbl_ent *e = &hwdrvdevtbl_idx.e[lo-1];
+	return ((addr < (e->addr + (e->mapsz*sizeof(unsigned long)))) ? e : (hwdrvdevtbl_ent *)0);
+}
+
 #endif /* HWDRVDEVTBL_H */
@@ -58,4 +58,89 @@ static inline unsigned long hwdrvintctrl_ena (unsigned long idx, unsigned long e
 	return intsrc;
 }
 
+// Max count of interrupt sources that can have a handler;
+// the field intridx from the device table must be less.
+#ifndef HWDRVINTCTRL_SRCMAX
+#define HWDRVINTCTRL_SRCMAX 32
+#endif
+
+// Index in hwdrvintctrl_srcs of the handler for the interrupts
+// triggered by CMDINTDST, which CMDACKINT returns as -1.
+#define HWDRVINTCTRL_IPI HWDRVINTCTRL_SRCMAX
+
+// Structure describing the handler of an interrupt source,
+// and the counters that hwdrvintctrl_drain() maintains for it.
+typedef struct {
+	// Function called with the argument arg when the source
+	// interrupts, or null if the source has no handler.
+	void (*fn) (void *arg);
+	void *arg;
+	// Count of interrupts dispatched.
+	unsigned long cnt;
+	// Clock cycles from the acknowledgement of an interrupt
+	// to the completion of its handler.
+	unsigned long latmin, latmax;
+	unsigned long long lattotal;
+} hwdrvintctrl_src;
+
+// Handlers indexed by interrupt source index,
+// followed by the one at HWDRVINTCTRL_IPI.
+static hwdrvintctrl_src hwdrvintctrl_srcs[HWDRVINTCTRL_SRCMAX+1];
+
+// Counters of hwdrvintctrl_drain().
+static struct {
+	// Count of calls which dispatched at least an interrupt.
+	unsigned long entrycnt;
+	// Count of interrupts from sources without handler.
+	unsigned long spuriouscnt;
+} hwdrvintctrl_stats;
+
+// Set the handler of the interrupt source given by the argument idx,
+// which is either the field intridx of a device from the device table,
+// or HWDRVINTCTRL_IPI; the source gets enabled if the argument fn is
+// non-null, otherwise disabled. Its counters get reset.
+static void hwdrvintctrl_sethdlr (unsigned long idx, void (*fn)(void *), void *arg) {
+	if (idx > HWDRVINTCTRL_IPI)
+		return;
+	hwdrvintctrl_srcs[idx] = (hwdrvintctrl_src){.fn = fn, .arg = arg, .latmin = -1};
+	if (idx != HWDRVINTCTRL_IPI)
+		hwdrvintctrl_ena (idx, !!fn);
+}
+
+// Acknowledge and dispatch the interrupts pending for the interrupt destination
+// given by the argument dst, until the interrupt controller returns -2 indicating
+// that none is pending, so that a burst of interrupts is handled in a single call.
+// Returns the count of interrupts dispatched.
+static unsigned long hwdrvintctrl_drain (unsigned long dst) {
+	unsigned long n = 0;
+	while (1) {
+		unsigned long start, end, idx;
+		__asm__ __volatile__ ("getclkcyclecnt %0" : "=r" (start));
+		if ((idx = hwdrvintctrl_ack (dst, 1)) == (unsigned long)-2)
+			break;
+		if (idx == (unsigned long)-1)
+			idx = HWDRVINTCTRL_IPI;
+		else if (idx >= HWDRVINTCTRL_SRCMAX)
+			idx = -1;
+		if (idx == (unsigned long)-1 || !hwdrvintctrl_srcs[idx].fn) {
+			++hwdrvintctrl_stats.spuriouscnt;
+			continue;
+		}
+		hwdrvintctrl_src *s = &hwdrvintctrl_srcs[idx];
+		s->fn (s->arg);
+		__asm__ __volatile__ ("getclkcyclecnt %0" : "=r" (end));
+		end -= start;
+		++s->cnt;
+		if (s->latmin > end)
+			s->latmin = end;
+		if (s->latmax < end)
+			s->latmax = end;
+		s->lattotal += end;
+		++n;
+	}
+	if (n)
+		++hwdrvintctrl_stats.entrycnt;
+	return n;
+}
+
 #endif /* HWDRVINTCTRL_H */
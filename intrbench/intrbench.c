@@ -0,0 +1,393 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// (c) William Fonkou Tambe
+
+// Benchmark of the interrupt controller through hwdrvintctrl.h,
+// reporting over the UART the latency histograms of inter-processor
+// interrupts sent with hwdrvintctrl_int() to this core and to the
+// parked cores, the max sustained rate at which they can be sent,
+// and how often the controller rejects them with -2, ie: not ready
+// due to an interrupt pending ack.
+// Parked cores are only targeted when the BIOS passed the address
+// of their mailboxes through the environment variable PARKMBX,
+// since they otherwise never acknowledge an interrupt.
+
+// Use as kernel:
+// sudo /opt/pu32-toolchain/bin/pu32-mksocimg -k intrbench.bin intrbench.img
+
+// Used to stringify.
+#define __xstr__(s) __str__(s)
+#define __str__(s) #s
+
+static unsigned char stack[STACKSZ] __attribute__((used));
+static unsigned char kstack[KSTACKSZ] __attribute__((used));
+
+// Index of this core, and the stack pointer set by the BIOS
+// which points to argc, followed by argv and envp arrays.
+static unsigned long coreid __attribute__((used));
+static unsigned long *bootsp __attribute__((used));
+
+// Substitute for crt0.S since this is built using -nostdlib.
+__asm__ (
+	".section .text._start\n"
+	".global  _start\n"
+	".type    _start, @function\n"
+	".p2align 1\n"
+	"_start:\n"
+
+	// Disable timer interrupts; enable instruction getclkcyclecnt;
+	// external interrupts are left enabled to receive the IPIs.
+	"li %sr, (0x1000 | 0x2000)\n"
+	"setflags %sr\n"
+	"li %sr, 0x1000\n"
+	"setksl %sr\n"
+
+	"rli %1, bootsp\n"
+	"st %sp, %1\n"
+	"getcoreid %2\n"
+	"rli %1, coreid\n"
+	"st %2, %1\n"
+
+	// Clear all TLB entries.
+	"gettlbsize %1\n"
+	"li %2, 12\n"
+	"sll %1, %2\n"
+	"li %3, 0\n"
+	"li %2, (1<<12)\n"
+	"0: sub %1, %2\n"
+	"clrtlb %3, %1\n"
+	"rli %sr, 0b\n"
+	"jnz %1, %sr\n"
+	"li %sr, 0\n" // %sr is expected to have the address of the Page-Global-Directory.
+	// Re-using %2 value to set userspace asid.
+	"setasid %2\n"
+
+	// Kernel-mode stack used by intrhdlr().
+	"rli %sp, kstack + "__xstr__(KSTACKSZ)"\n"
+	"li8 %fp, 0\n"
+
+	// Continue execution in usermode.
+	"rli %sr, 1f\n"
+	"setuip %sr\n"
+	"0: sysret\n"
+
+	// Assumption is that the interrupt is either a ReadFaultIntr,
+	// WriteFaultIntr, ExecFaultIntr, or otherwise an external
+	// interrupt, which intrhdlr() acknowledges and dispatches.
+
+	"getfaultreason %1\n"
+	"li %2, 2\n" // ExecFaultIntr.
+	"sltu %2, %1\n"
+	"rli %sr, 20f; jz %2, %sr\n"
+	"rli %sr, intrhdlr\n"
+	"jl %rp, %sr\n"
+	"rli %sr, 0b; j %sr; 20:\n"
+
+	"li %2, 2\n" // ExecFaultIntr.
+	"li %3, 0b10001\n" // user::::executable:
+	"seq %1, %2; rli %sr, 10f; jnz %1, %sr\n"
+	"li %3, 0b10110; 10:\n" // user::readable:writable::
+
+	"getfaultaddr %1\n"
+
+	"li %2, 0xfff\n"
+	"li %4, 3\n"
+	"not %5, %2\n"
+
+	"and %1, %5\n"
+	"cpy %6, %1\n"
+	"or %6, %3\n"
+	// Enable caching if page is not at address 0.
+	"cpy %7, %1\n"
+	"slte %7, %2\n"
+	"sll %7, %4\n"
+	"or %6, %7\n"
+
+	"settlb %6, %1\n"
+
+	"rli %sr, 0b; j %sr; 1:\n"
+
+	// Initialize %sp and %fp.
+	"rli %sp, stack + "__xstr__(STACKSZ)"\n"
+	"li8 %fp, 0\n"
+	// Call main().
+	"rli %sr, main\n"
+	"jl %rp, %sr\n"
+	// We should never return from above jl,
+	// otherwise we must infinite loop.
+	"j %rp\n"
+
+	".size    _start, (. - _start)\n");
+
+#include <hwdrvchar/hwdrvchar.h>
+hwdrvchar hwdrvchar_dev = {.addr = (void *)UARTADDR};
+
+#include <cons/cons.h>
+cons cons_dev = {.dev = &hwdrvchar_dev};
+
+int putchar (int c) {
+	cons_putc (&cons_dev, c);
+	return c;
+}
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static void puts_dec (unsigned long n) {
+	char s[ITOA_BUFSZ];
+	puts(itoa(n, s, 10));
+}
+
+#include <hwdrvintctrl/hwdrvintctrl.h>
+#include <hwdesc/hwdesc.h>
+
+static inline unsigned long clkcyclecnt (void) {
+	unsigned long n;
+	__asm__ __volatile__ ("getclkcyclecnt %0" : "=r" (n));
+	return n;
+}
+
+static inline unsigned long clkfreq (void) {
+	unsigned long freq;
+	__asm__ __volatile__ ("getclkfreq %0\n" : "=r"(freq));
+	return freq;
+}
+
+// Count of IPIs dispatched to this core, and lower bits of the
+// clock cycle count when the latest one entered intrhdlr(),
+// and when its handler got called once acknowledged.
+static volatile unsigned long ipicnt, entryclk, ipiclk;
+
+static void ipihdlr (void *arg) {
+	ipiclk = clkcyclecnt();
+	++ipicnt;
+}
+
+// Called in kernel-mode by _start upon an external interrupt.
+void intrhdlr (void) {
+	entryclk = clkcyclecnt();
+	hwdrvintctrl_drain (coreid);
+}
+
+// Mailbox of a parked core, as laid out by parkpu_mbox from the BIOS.
+typedef struct {
+	void (* volatile fn) (void *arg);
+	void * volatile arg;
+	volatile unsigned long donecnt;
+	volatile unsigned long postclkcyclecnt, wakeclkcyclecnt;
+} parkmbx;
+
+// Posted to a parked core, which times its wake up.
+static void parkmbx_nop (void *arg) {}
+
+// Return the value of the environment variable given by the argument
+// name, including its '=', as the BIOS sets it, ie: the binary value
+// of a pointer following the '='; null if the variable is not set.
+static unsigned long getenvptr (char *name) {
+	char **envp = (char **)&bootsp[bootsp[0] + 2];
+	for (; *envp; ++envp) {
+		char *e = *envp;
+		unsigned long i = 0;
+		while (name[i] && name[i] == e[i])
+			++i;
+		if (!name[i])
+			return *(unsigned long *)(e + i);
+	}
+	return 0;
+}
+
+// Latency histogram, where cnt[i] counts the
+// interrupts having taken from 2^i to (2^(i+1))-1 clock cycles.
+typedef struct {
+	unsigned long cnt[8*__SIZEOF_POINTER__];
+	unsigned long n, min, max;
+	unsigned long long total;
+} hist;
+
+static void histreset (hist *h) {
+	for (unsigned long i = 0; i < (sizeof(h->cnt)/sizeof(h->cnt[0])); ++i)
+		h->cnt[i] = 0;
+	h->n = 0;
+	h->min = -1;
+	h->max = 0;
+	h->total = 0;
+}
+
+// Account an interrupt having taken the clock cycles given by the argument cycles.
+static void histadd (hist *h, unsigned long cycles) {
+	++h->n;
+	if (cycles < h->min)
+		h->min = cycles;
+	if (cycles > h->max)
+		h->max = cycles;
+	h->total += cycles;
+	unsigned long i = 0;
+	while (cycles >>= 1)
+		++i;
+	++h->cnt[i];
+}
+
+static void histreport (char *name, hist *h) {
+	puts(name);
+	if (!h->n) {
+		puts(": none\n");
+		return;
+	}
+	puts(": clk min "); puts_dec(h->min);
+	puts(" avg "); puts_dec(h->total / h->n);
+	puts(" max "); puts_dec(h->max);
+	putchar('\n');
+	for (unsigned long i = 0; i < (sizeof(h->cnt)/sizeof(h->cnt[0])); ++i) {
+		if (!h->cnt[i])
+			continue;
+		puts("  clk < "); puts_dec(2 << i);
+		puts(": "); puts_dec(h->cnt[i]);
+		putchar('\n');
+	}
+}
+
+// Histograms of the test in progress, respectively of the clock cycles from
+// hwdrvintctrl_int() to the interrupt handler being entered, from then to
+// the interrupt acknowledgement having returned, and from hwdrvintctrl_int()
+// to the sender having observed the interrupt handled.
+static hist trighist, ackhist, rthist;
+
+// Count of hwdrvintctrl_int() having returned -2 during the test in progress.
+static unsigned long rejcnt;
+
+// Send to the core given by the argument dst an IPI, retrying while
+// the controller returns -2, which gets accounted in rejcnt.
+// Returns 1 on success, otherwise 0 if dst is invalid.
+static unsigned long sendipi (unsigned long dst) {
+	unsigned long ret;
+	while ((ret = hwdrvintctrl_int (dst)) == (unsigned long)-2)
+		++rejcnt;
+	return (ret != (unsigned long)-1);
+}
+
+// Send INTRBENCHOPCNT IPIs to this core, each once the previous one was handled.
+static void runself (void) {
+	histreset (&trighist); histreset (&ackhist); histreset (&rthist);
+	rejcnt = 0;
+	unsigned long freq = clkfreq();
+	for (unsigned long i = 0; i < INTRBENCHOPCNT; ++i) {
+		unsigned long n = ipicnt;
+		unsigned long t = clkcyclecnt();
+		if (!sendipi (coreid)) {
+			puts("! self IPI invalid\n");
+			return;
+		}
+		while (ipicnt == n) {
+			if ((clkcyclecnt() - t) > freq) {
+				puts("! self IPI not delivered\n");
+				return;
+			}
+		}
+		histadd (&rthist, clkcyclecnt() - t);
+		histadd (&trighist, entryclk - t);
+		histadd (&ackhist, ipiclk - entryclk);
+	}
+	histreport ("self trigger-to-handler", &trighist);
+	histreport ("self ack", &ackhist);
+	histreport ("self round-trip", &rthist);
+	puts("self rejects "); puts_dec(rejcnt); putchar('\n');
+}
+
+// Post INTRBENCHOPCNT times to the mailbox of the parked core given
+// by the argument id, each once the previous post has completed;
+// the wake latency measured by the parked core is its trigger-to-handler.
+// Returns 1 on success, otherwise 0.
+static unsigned long runcore (parkmbx *m, unsigned long id) {
+	histreset (&trighist); histreset (&rthist);
+	rejcnt = 0;
+	unsigned long freq = clkfreq();
+	for (unsigned long i = 0; i < INTRBENCHOPCNT; ++i) {
+		m->arg = (void *)0;
+		unsigned long t = clkcyclecnt();
+		m->postclkcyclecnt = t;
+		m->fn = parkmbx_nop;
+		if (!sendipi (id)) {
+			m->fn = (void (*)(void *))0;
+			puts("! core "); puts_dec(id); puts(" IPI invalid\n");
+			return 0;
+		}
+		while (m->fn) {
+			if ((clkcyclecnt() - t) > freq) {
+				puts("! core "); puts_dec(id); puts(" not woken\n");
+				return 0;
+			}
+		}
+		histadd (&trighist, m->wakeclkcyclecnt);
+		histadd (&rthist, clkcyclecnt() - t);
+	}
+	puts("core "); puts_dec(id); putchar('\n');
+	histreport ("trigger-to-handler", &trighist);
+	histreport ("round-trip", &rthist);
+	puts("rejects "); puts_dec(rejcnt); putchar('\n');
+	return 1;
+}
+
+// Send INTRBENCHOPCNT IPIs back-to-back to the core given by the argument
+// dst, and report the rate at which the controller accepted them, along with
+// how many attempts it rejected with -2 because the previous IPI was pending ack.
+static void runrate (char *name, unsigned long dst) {
+	rejcnt = 0;
+	unsigned long n = ipicnt;
+	unsigned long t = clkcyclecnt();
+	for (unsigned long i = 0; i < INTRBENCHOPCNT; ++i) {
+		if (!sendipi (dst)) {
+			puts("! IPI invalid\n");
+			return;
+		}
+	}
+	// IPIs sent to this core are only accounted once handled.
+	if (dst == coreid) {
+		unsigned long freq = clkfreq();
+		while ((ipicnt - n) < INTRBENCHOPCNT) {
+			if ((clkcyclecnt() - t) > freq) {
+				puts("! IPI not delivered\n");
+				return;
+			}
+		}
+	}
+	t = (clkcyclecnt() - t);
+	puts(name); putchar(' '); puts_dec(dst);
+	puts(" rate: intr/s "); puts_dec(((unsigned long long)INTRBENCHOPCNT * clkfreq()) / (t ?: 1));
+	puts(" rejects "); puts_dec(rejcnt);
+	puts(" of "); puts_dec(rejcnt + INTRBENCHOPCNT);
+	puts(" attempts\n");
+}
+
+void main (void) {
+	hwdrvchar_init (&hwdrvchar_dev, UARTBAUD);
+	puts("intrbench\n");
+	puts("core "); puts_dec(coreid);
+	puts(" clkfreq "); puts_dec(clkfreq()); putchar('\n');
+	hwdrvintctrl_sethdlr (HWDRVINTCTRL_IPI, ipihdlr, (void *)0);
+	parkmbx *mbx = (parkmbx *)getenvptr("PARKMBX=");
+	hwdesc *hd = (hwdesc *)getenvptr("HWDESCR=");
+	// Cores up to hwdesc.maxcorecnt are tried, since the count of cores
+	// present is unknown; a core found absent, ie: whose IPI is invalid
+	// or which does not wake up, does not get tried again.
+	unsigned long maxcorecnt = ((hd && hd->magic == HWDESC_MAGIC) ? hd->maxcorecnt : 1);
+	if (maxcorecnt > INTRBENCHMAXCORECNT)
+		maxcorecnt = INTRBENCHMAXCORECNT;
+	static unsigned char absent[INTRBENCHMAXCORECNT];
+	if (maxcorecnt > 1 && !mbx)
+		puts("! no parked core mailboxes; other cores not tested\n");
+	while (1) {
+		runself();
+		runrate ("self", coreid);
+		for (unsigned long id = 0; mbx && id < maxcorecnt; ++id) {
+			if (id == coreid || absent[id])
+				continue;
+			if (!runcore (&mbx[id], id)) {
+				absent[id] = 1;
+				continue;
+			}
+			runrate ("core", id);
+		}
+		puts("intr entries "); puts_dec(hwdrvintctrl_stats.entrycnt);
+		puts(" spurious "); puts_dec(hwdrvintctrl_stats.spuriouscnt);
+		puts("\ndone\n");
+	}
+}
@@ -0,0 +1,9 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// (c) William Fonkou Tambe
+
+#define STACKSZ		512 /* estimate: about 330 bytes from host i386 -fstack-usage outputs; re-check with pu32 ones */
+#define KSTACKSZ	256 /* stack of the kernel-mode interrupt handler */
+#define UARTADDR	(0x0ff8 /* By convention, the first UART is located at 0x0ff8 */)
+#define UARTBAUD	115200
+#define INTRBENCHOPCNT	1024 /* interrupts per test */
+#define INTRBENCHMAXCORECNT	64 /* max count of cores tested */
@@ -122,8 +122,11 @@ __asm__ (
 #include <hwdrvchar/hwdrvchar.h>
 hwdrvchar hwdrvchar_dev = {.addr = (void *)UARTADDR};
 
+#include <cons/cons.h>
+cons cons_dev = {.dev = &hwdrvchar_dev};
+
 int putchar (int c) {
-	while (!hwdrvchar_write(&hwdrvchar_dev, &c, 1));
+	cons_putc (&cons_dev, c);
 	return c;
 }
 
@@ -193,14 +196,13 @@ unsigned long ptrbitoff;
 unsigned long ptrbitpos;
 unsigned long ptrbitpos_plus_ptrbitoff;
 
-void main (void) {
+static void memtest (void) {
 	hwdrvchar_init (&hwdrvchar_dev, UARTBAUD);
-	hwdrvdevtbl hwdrvdevtbl_dev = {.e = (devtblentry *)0, .id = 1 /* RAM device */};
-	hwdrvdevtbl_find (&hwdrvdevtbl_dev, 0);
-	if (!hwdrvdevtbl_dev.mapsz)
+	hwdrvdevtbl_ent *ram = hwdrvdevtbl_nth (1 /* RAM device */, 0);
+	if (!ram)
 		{puts("! memory not found\n"); return;};
-	void *memstartaddr = hwdrvdevtbl_dev.addr;
-	unsigned long memsz = (hwdrvdevtbl_dev.mapsz * sizeof(unsigned long));
+	void *memstartaddr = ram->addr;
+	unsigned long memsz = (ram->mapsz * sizeof(unsigned long));
 	ptrbitsz = -1;
 	for (unsigned long n = memsz; n; n >>= 1)
 		++ptrbitsz;
@@ -243,6 +245,13 @@ void main (void) {
 	goto test_begin;
 }
 
+void main (void) {
+	memtest();
+	// Drain output still buffered before returning
+	// to _start which infinite loops.
+	cons_flush (&cons_dev);
+}
+
 extern void *__executable_start, *_end;
 
 #include <bitmanip.h>
@@ -255,7 +264,7 @@ unsigned long mem8test (void *startaddr, void *endaddr) {
 	for (volatile uint8_t *ptr_ = startaddr; ptr_ < (typeof(ptr_))endaddr; (ptr_ = (typeof(ptr_))((void *)ptr_ + 1))) {
 		unsigned long remaining = ((unsigned long)endaddr - (unsigned long)ptr_);
 		if (!(remaining%progressmodulo)) {
-			puts(RESETLINE); puts_hex(remaining/progressmodulo);
+			puts(RESETLINE); puts_hex(remaining/progressmodulo); cons_flush (&cons_dev);
 		}
 		volatile uint8_t *ptr = ((void *)BITROR(
 			((unsigned long)ptr_ - (unsigned long)startaddr),
@@ -279,7 +288,7 @@ unsigned long mem8test (void *startaddr, void *endaddr) {
 	for (volatile uint8_t *ptr_ = startaddr; ptr_ < (typeof(ptr_))endaddr; (ptr_ = (typeof(ptr_))((void *)ptr_ + 1))) {
 		unsigned long remaining = ((unsigned long)endaddr - (unsigned long)ptr_);
 		if (!(remaining%progressmodulo)) {
-			puts(RESETLINE); puts_hex(remaining/progressmodulo);
+			puts(RESETLINE); puts_hex(remaining/progressmodulo); cons_flush (&cons_dev);
 		}
 		volatile uint8_t *ptr = ((void *)BITROR(
 			((unsigned long)ptr_ - (unsigned long)startaddr),
@@ -314,7 +323,7 @@ unsigned long mem8test (void *startaddr, void *endaddr) {
 	for (volatile uint8_t *ptr_ = startaddr; ptr_ < (typeof(ptr_))endaddr; (ptr_ = (typeof(ptr_))((void *)ptr_ + 1))) {
 		unsigned long remaining = ((unsigned long)endaddr - (unsigned long)ptr_);
 		if (!(remaining%progressmodulo)) {
-			puts(RESETLINE); puts_hex(remaining/progressmodulo);
+			puts(RESETLINE); puts_hex(remaining/progressmodulo); cons_flush (&cons_dev);
 		}
 		volatile uint8_t *ptr = ((void *)BITROR(
 			((unsigned long)ptr_ - (unsigned long)startaddr),
@@ -338,7 +347,7 @@ unsigned long mem8test (void *startaddr, void *endaddr) {
 	for (volatile uint8_t *ptr_ = startaddr; ptr_ < (typeof(ptr_))endaddr; (ptr_ = (typeof(ptr_))((void *)ptr_ + 1))) {
 		unsigned long remaining = ((unsigned long)endaddr - (unsigned long)ptr_);
 		if (!(remaining%progressmodulo)) {
-			puts(RESETLINE); puts_hex(remaining/progressmodulo);
+			puts(RESETLINE); puts_hex(remaining/progressmodulo); cons_flush (&cons_dev);
 		}
 		volatile uint8_t *ptr = ((void *)BITROR(
 			((unsigned long)ptr_ - (unsigned long)startaddr),
@@ -364,7 +373,7 @@ unsigned long mem8test (void *startaddr, void *endaddr) {
 	for (volatile uint8_t *ptr_ = startaddr; ptr_ < (typeof(ptr_))endaddr; (ptr_ = (typeof(ptr_))((void *)ptr_ + 1))) {
 		unsigned long remaining = ((unsigned long)endaddr - (unsigned long)ptr_);
 		if (!(remaining%progressmodulo)) {
-			puts(RESETLINE); puts_hex(remaining/progressmodulo);
+			puts(RESETLINE); puts_hex(remaining/progressmodulo); cons_flush (&cons_dev);
 		}
 		volatile uint8_t *ptr = ((void *)BITROR(
 			((unsigned long)ptr_ - (unsigned long)startaddr),
@@ -393,7 +402,7 @@ unsigned long mem16test (void *startaddr, void *endaddr) {
 	for (volatile uint16_t *ptr_ = startaddr; ptr_ < (typeof(ptr_))endaddr; (ptr_ = (typeof(ptr_))((void *)ptr_ + 1))) {
 		unsigned long remaining = ((unsigned long)endaddr - (unsigned long)ptr_);
 		if (!(remaining%progressmodulo)) {
-			puts(RESETLINE); puts_hex(remaining/progressmodulo);
+			puts(RESETLINE); puts_hex(remaining/progressmodulo); cons_flush (&cons_dev);
 		}
 		volatile uint16_t *ptr = ((void *)BITROR(
 			((unsigned long)ptr_ - (unsigned long)startaddr),
@@ -418,7 +427,7 @@ unsigned long mem16test (void *startaddr, void *endaddr) {
 	for (volatile uint16_t *ptr_ = startaddr; ptr_ < (typeof(ptr_))endaddr; (ptr_ = (typeof(ptr_))((void *)ptr_ + 1))) {
 		unsigned long remaining = ((unsigned long)endaddr - (unsigned long)ptr_);
 		if (!(remaining%progressmodulo)) {
-			puts(RESETLINE); puts_hex(remaining/progressmodulo);
+			puts(RESETLINE); puts_hex(remaining/progressmodulo); cons_flush (&cons_dev);
 		}
 		volatile uint16_t *ptr = ((void *)BITROR(
 			((unsigned long)ptr_ - (unsigned long)startaddr),
@@ -454,7 +463,7 @@ unsigned long mem16test (void *startaddr, void *endaddr) {
 	for (volatile uint16_t *ptr_ = startaddr; ptr_ < (typeof(ptr_))endaddr; (ptr_ = (typeof(ptr_))((void *)ptr_ + 1))) {
 		unsigned long remaining = ((unsigned long)endaddr - (unsigned long)ptr_);
 		if (!(remaining%progressmodulo)) {
-			puts(RESETLINE); puts_hex(remaining/progressmodulo);
+			puts(RESETLINE); puts_hex(remaining/progressmodulo); cons_flush (&cons_dev);
 		}
 		volatile uint16_t *ptr = ((void *)BITROR(
 			((unsigned long)ptr_ - (unsigned long)startaddr),
@@ -479,7 +488,7 @@ unsigned long mem16test (void *startaddr, void *endaddr) {
 	for (volatile uint16_t *ptr_ = startaddr; ptr_ < (typeof(ptr_))endaddr; (ptr_ = (typeof(ptr_))((void *)ptr_ + 1))) {
 		unsigned long remaining = ((unsigned long)endaddr - (unsigned long)ptr_);
 		if (!(remaining%progressmodulo)) {
-			puts(RESETLINE); puts_hex(remaining/progressmodulo);
+			puts(RESETLINE); puts_hex(remaining/progressmodulo); cons_flush (&cons_dev);
 		}
 		volatile uint16_t *ptr = ((void *)BITROR(
 			((unsigned long)ptr_ - (unsigned long)startaddr),
@@ -506,7 +515,7 @@ unsigned long mem16test (void *startaddr, void *endaddr) {
 	for (volatile uint16_t *ptr_ = startaddr; ptr_ < (typeof(ptr_))endaddr; (ptr_ = (typeof(ptr_))((void *)ptr_ + 1))) {
 		unsigned long remaining = ((unsigned long)endaddr - (unsigned long)ptr_);
 		if (!(remaining%progressmodulo)) {
-			puts(RESETLINE); puts_hex(remaining/progressmodulo);
+			puts(RESETLINE); puts_hex(remaining/progressmodulo); cons_flush (&cons_dev);
 		}
 		volatile uint16_t *ptr = ((void *)BITROR(
 			((unsigned long)ptr_ - (unsigned long)startaddr),
@@ -537,7 +546,7 @@ unsigned long mem32test (void *startaddr, void *endaddr) {
 	for (volatile uint32_t *ptr_ = startaddr; ptr_ < (typeof(ptr_))endaddr; (ptr_ = (typeof(ptr_))((void *)ptr_ + 1))) {
 		unsigned long remaining = ((unsigned long)endaddr - (unsigned long)ptr_);
 		if (!(remaining%progressmodulo)) {
-			puts(RESETLINE); puts_hex(remaining/progressmodulo);
+			puts(RESETLINE); puts_hex(remaining/progressmodulo); cons_flush (&cons_dev);
 		}
 		volatile uint32_t *ptr = ((void *)BITROR(
 			((unsigned long)ptr_ - (unsigned long)startaddr),
@@ -562,7 +571,7 @@ unsigned long mem32test (void *startaddr, void *endaddr) {
 	for (volatile uint32_t *ptr_ = startaddr; ptr_ < (typeof(ptr_))endaddr; (ptr_ = (typeof(ptr_))((void *)ptr_ + 1))) {
 		unsigned long remaining = ((unsigned long)endaddr - (unsigned long)ptr_);
 		if (!(remaining%progressmodulo)) {
-			puts(RESETLINE); puts_hex(remaining/progressmodulo);
+			puts(RESETLINE); puts_hex(remaining/progressmodulo); cons_flush (&cons_dev);
 		}
 		volatile uint32_t *ptr = ((void *)BITROR(
 			((unsigned long)ptr_ - (unsigned long)startaddr),
@@ -598,7 +607,7 @@ unsigned long mem32test (void *startaddr, void *endaddr) {
 	for (volatile uint32_t *ptr_ = startaddr; ptr_ < (typeof(ptr_))endaddr; (ptr_ = (typeof(ptr_))((void *)ptr_ + 1))) {
 		unsigned long remaining = ((unsigned long)endaddr - (unsigned long)ptr_);
 		if (!(remaining%progressmodulo)) {
-			puts(RESETLINE); puts_hex(remaining/progressmodulo);
+			puts(RESETLINE); puts_hex(remaining/progressmodulo); cons_flush (&cons_dev);
 		}
 		volatile uint32_t *ptr = ((void *)BITROR(
 			((unsigned long)ptr_ - (unsigned long)startaddr),
@@ -623,7 +632,7 @@ unsigned long mem32test (void *startaddr, void *endaddr) {
 	for (volatile uint32_t *ptr_ = startaddr; ptr_ < (typeof(ptr_))endaddr; (ptr_ = (typeof(ptr_))((void *)ptr_ + 1))) {
 		unsigned long remaining = ((unsigned long)endaddr - (unsigned long)ptr_);
 		if (!(remaining%progressmodulo)) {
-			puts(RESETLINE); puts_hex(remaining/progressmodulo);
+			puts(RESETLINE); puts_hex(remaining/progressmodulo); cons_flush (&cons_dev);
 		}
 		volatile uint32_t *ptr = ((void *)BITROR(
 			((unsigned long)ptr_ - (unsigned long)startaddr),
@@ -650,7 +659,7 @@ unsigned long mem32test (void *startaddr, void *endaddr) {
 	for (volatile uint32_t *ptr_ = startaddr; ptr_ < (typeof(ptr_))endaddr; (ptr_ = (typeof(ptr_))((void *)ptr_ + 1))) {
 		unsigned long remaining = ((unsigned long)endaddr - (unsigned long)ptr_);
 		if (!(remaining%progressmodulo)) {
-			puts(RESETLINE); puts_hex(remaining/progressmodulo);
+			puts(RESETLINE); puts_hex(remaining/progressmodulo); cons_flush (&cons_dev);
 		}
 		volatile uint32_t *ptr = ((void *)BITROR(
 			((unsigned long)ptr_ - (unsigned long)startaddr),
@@ -681,7 +690,7 @@ unsigned long mem64test (void *startaddr, void *endaddr) {
 	for (volatile uint64_t *ptr_ = startaddr; ptr_ < (typeof(ptr_))endaddr; (ptr_ = (typeof(ptr_))((void *)ptr_ + 1))) {
 		unsigned long remaining = ((unsigned long)endaddr - (unsigned long)ptr_);
 		if (!(remaining%progressmodulo)) {
-			puts(RESETLINE); puts_hex(remaining/progressmodulo);
+			puts(RESETLINE); puts_hex(remaining/progressmodulo); cons_flush (&cons_dev);
 		}
 		volatile uint64_t *ptr = ((void *)BITROR(
 			((unsigned long)ptr_ - (unsigned long)startaddr),
@@ -706,7 +715,7 @@ unsigned long mem64test (void *startaddr, void *endaddr) {
 	for (volatile uint64_t *ptr_ = startaddr; ptr_ < (typeof(ptr_))endaddr; (ptr_ = (typeof(ptr_))((void *)ptr_ + 1))) {
 		unsigned long remaining = ((unsigned long)endaddr - (unsigned long)ptr_);
 		if (!(remaining%progressmodulo)) {
-			puts(RESETLINE); puts_hex(remaining/progressmodulo);
+			puts(RESETLINE); puts_hex(remaining/progressmodulo); cons_flush (&cons_dev);
 		}
 		volatile uint64_t *ptr = ((void *)BITROR(
 			((unsigned long)ptr_ - (unsigned long)startaddr),
@@ -742,7 +751,7 @@ unsigned long mem64test (void *startaddr, void *endaddr) {
 	for (volatile uint64_t *ptr_ = startaddr; ptr_ < (typeof(ptr_))endaddr; (ptr_ = (typeof(ptr_))((void *)ptr_ + 1))) {
 		unsigned long remaining = ((unsigned long)endaddr - (unsigned long)ptr_);
 		if (!(remaining%progressmodulo)) {
-			puts(RESETLINE); puts_hex(remaining/progressmodulo);
+			puts(RESETLINE); puts_hex(remaining/progressmodulo); cons_flush (&cons_dev);
 		}
 		volatile uint64_t *ptr = ((void *)BITROR(
 			((unsigned long)ptr_ - (unsigned long)startaddr),
@@ -767,7 +776,7 @@ unsigned long mem64test (void *startaddr, void *endaddr) {
 	for (volatile uint64_t *ptr_ = startaddr; ptr_ < (typeof(ptr_))endaddr; (ptr_ = (typeof(ptr_))((void *)ptr_ + 1))) {
 		unsigned long remaining = ((unsigned long)endaddr - (unsigned long)ptr_);
 		if (!(remaining%progressmodulo)) {
-			puts(RESETLINE); puts_hex(remaining/progressmodulo);
+			puts(RESETLINE); puts_hex(remaining/progressmodulo); cons_flush (&cons_dev);
 		}
 		volatile uint64_t *ptr = ((void *)BITROR(
 			((unsigned long)ptr_ - (unsigned long)startaddr),
@@ -794,7 +803,7 @@ unsigned long mem64test (void *startaddr, void *endaddr) {
 	for (volatile uint64_t *ptr_ = startaddr; ptr_ < (typeof(ptr_))endaddr; (ptr_ = (typeof(ptr_))((void *)ptr_ + 1))) {
 		unsigned long remaining = ((unsigned long)endaddr - (unsigned long)ptr_);
 		if (!(remaining%progressmodulo)) {
-			puts(RESETLINE); puts_hex(remaining/progressmodulo);
+			puts(RESETLINE); puts_hex(remaining/progressmodulo); cons_flush (&cons_dev);
 		}
 		volatile uint64_t *ptr = ((void *)BITROR(
 			((unsigned long)ptr_ - (unsigned long)startaddr),
@@ -0,0 +1,65 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// (c) William Fonkou Tambe
+
+#ifndef UARTBOOT_H
+#define UARTBOOT_H
+
+// Protocol used by host tools to send the BIOS, through the UART,
+// the kernel to boot instead of the one from the block device.
+// - The host repeatedly sends UARTBOOT_KEY while the BIOS boots;
+//   the BIOS replies UARTBOOT_READY when it enters UART boot mode.
+// - The host sends frames formatted as follow:
+//   |type: 1byte|seq: 2bytes|len: 2bytes|payload: len bytes|crc: 4bytes|
+//   where seq, len and crc are in little-endian, and crc is the
+//   uartboot_crc32() of all preceding bytes of the frame.
+//   - UARTBOOT_HDR: seq is 0; the payload is the image byte size
+//   followed by the uartboot_crc32() of the image, each 4 bytes.
+//   - UARTBOOT_DATA: seq is the index of the frame within the image,
+//   and the payload is the UARTBOOT_FRAMESZ bytes of the image at
+//   (seq*UARTBOOT_FRAMESZ), or less for the last frame.
+//   - UARTBOOT_END: seq is 0; there is no payload.
+// - The BIOS replies to each frame received intact with the following:
+//   |(type^UARTBOOT_ACKMASK): 1byte|seq: 2bytes|~seq: 2bytes|
+//   or with UARTBOOT_NAK instead of (type^UARTBOOT_ACKMASK) when
+//   the frame cannot be accepted; frames received damaged are dropped.
+// - The host keeps up to UARTBOOT_WINDOW data frames unacknowledged,
+//   and retransmits those whose acknowledgement has not been received
+//   within its timeout; frames can be received more than once.
+// - Once all data frames were acknowledged, the host sends UARTBOOT_END,
+//   for which the BIOS checks the crc of the whole image, and on success
+//   jumps to the kernel after acknowledging it; otherwise it replies
+//   UARTBOOT_NAK and waits for a new UARTBOOT_HDR.
+
+#define UARTBOOT_KEY		0x02 /* ctrl+B */
+#define UARTBOOT_READY		0x06
+#define UARTBOOT_HDR		0x81
+#define UARTBOOT_DATA		0x82
+#define UARTBOOT_END		0x83
+#define UARTBOOT_ACKMASK	0x80
+#define UARTBOOT_NAK		0x15
+#define UARTBOOT_FRAMESZ	1024
+#define UARTBOOT_WINDOW		16
+#define UARTBOOT_HDRSZ		5
+#define UARTBOOT_TIMEOUT	100 /* ms within which bytes of a frame must follow each other */
+
+// Return the crc32 (IEEE 802.3) of the byte amount given by the argument sz
+// from the buffer given by the argument ptr, continuing from the crc32 given
+// by the argument crc, which must be 0 for the first buffer.
+// It uses a 4bits lookup table to remain compact.
+static uint32_t uartboot_crc32 (uint32_t crc, void *ptr, unsigned long sz) {
+	static const uint32_t t[16] = {
+		0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac,
+		0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+		0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c,
+		0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c };
+	unsigned char *p = ptr;
+	crc = ~crc;
+	while (sz--) {
+		crc ^= *p++;
+		crc = ((crc >> 4) ^ t[crc & 0xf]);
+		crc = ((crc >> 4) ^ t[crc & 0xf]);
+	}
+	return ~crc;
+}
+
+#endif /* UARTBOOT_H */